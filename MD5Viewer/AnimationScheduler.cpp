@@ -0,0 +1,177 @@
+#include "AnimationScheduler.h"
+#include "JobSystem.h"
+#include "Timer.h"
+#include <algorithm>
+
+//Keeps small models from starving, their priority still grows with time
+#define SCHEDULER_MIN_SCREEN_SIZE	0.01f
+//Weight of the newest sample in the running update cost
+#define SCHEDULER_COST_SMOOTHING	0.2f
+/*
+=============
+AnimationScheduler::AnimationScheduler
+
+	AnimationScheduler Constructor.
+=============
+*/
+AnimationScheduler::AnimationScheduler( void ) :
+	budgetMilliseconds( 0.0f )
+{}
+/*
+=============
+AnimationScheduler::~AnimationScheduler
+
+	AnimationScheduler Destructor.
+	The models are not owned by the scheduler.
+=============
+*/
+AnimationScheduler::~AnimationScheduler( void ) {
+	for ( std::vector<ScheduledModel>::iterator scheduled = scheduledModels.begin();
+		  scheduled != scheduledModels.end(); ++scheduled ) {
+		scheduled->model->SetPoseHistoryEnabled( false );
+	}
+}
+/*
+=============
+AnimationScheduler::CreateAnimationScheduler
+
+	Creates a scheduler that spends at most budgetMilliseconds
+	of CPU time per frame on model updates.
+=============
+*/
+AnimationScheduler* AnimationScheduler::CreateAnimationScheduler( float budgetMilliseconds ) {
+	AnimationScheduler* scheduler = new AnimationScheduler();
+
+	if ( scheduler == NULL ) {
+		return NULL;
+	}
+
+	scheduler->SetBudget( budgetMilliseconds );
+	GetTimeMilliseconds(); //Set the timer's frequency up here, Update reads it from jobs
+	return scheduler;
+}
+/*
+=============
+AnimationScheduler::AddModel
+
+	Starts scheduling a model.
+=============
+*/
+void AnimationScheduler::AddModel( MD5Model* model ) {
+	if ( model == NULL ) {
+		return;
+	}
+
+	for ( std::vector<ScheduledModel>::iterator scheduled = scheduledModels.begin();
+		  scheduled != scheduledModels.end(); ++scheduled ) {
+		if ( scheduled->model == model ) {
+			return;
+		}
+	}
+
+	ScheduledModel scheduled;
+	scheduled.model					= model;
+	scheduled.pendingTime			= 0.0f;
+	scheduled.priority				= 0.0f;
+	scheduled.costMilliseconds		= 0.0f;
+	scheduled.lastCostMilliseconds	= 0.0f;
+	scheduledModels.push_back( scheduled );
+
+	model->SetPoseHistoryEnabled( true );
+}
+/*
+=============
+AnimationScheduler::RemoveModel
+
+	Stops scheduling a model.
+=============
+*/
+void AnimationScheduler::RemoveModel( MD5Model* model ) {
+	for ( std::vector<ScheduledModel>::iterator scheduled = scheduledModels.begin();
+		  scheduled != scheduledModels.end(); ++scheduled ) {
+		if ( scheduled->model == model ) {
+			model->SetPoseHistoryEnabled( false );
+			scheduledModels.erase( scheduled );
+			return;
+		}
+	}
+}
+/*
+=============
+AnimationScheduler::Update
+
+	Updates the most important models that fit in the budget,
+	using the running cost of each model to estimate what fits.
+	The top model is always updated so the scheduler can't stall.
+	Every other model is extrapolated.
+=============
+*/
+void AnimationScheduler::Update( float dt, const glm::vec3& cameraPosition, float tanHalfFieldOfView, JobSystem* jobSystem ) {
+	stats						= AnimationSchedulerStats();
+	stats.budgetMilliseconds	= budgetMilliseconds;
+
+	updateOrder.resize( scheduledModels.size() );
+	for ( unsigned i = 0; i < scheduledModels.size(); ++i ) {
+		ScheduledModel& scheduled	= scheduledModels[i];
+		float screenSize			= scheduled.model->ComputeScreenSize( cameraPosition, tanHalfFieldOfView );
+
+		scheduled.pendingTime		+= dt;
+		scheduled.priority			= std::max( screenSize, SCHEDULER_MIN_SCREEN_SIZE ) * scheduled.pendingTime;
+		updateOrder[i]				= i;
+	}
+
+	const std::vector<ScheduledModel>& models = scheduledModels;
+	std::sort( updateOrder.begin(), updateOrder.end(), [&models]( unsigned a, unsigned b ) {
+		return models[a].priority > models[b].priority;
+	} );
+
+	//Pick the models that fit, the rest are extrapolated
+	selectedModels.clear();
+	float estimatedCost = 0.0f;
+	for ( std::vector<unsigned>::iterator index = updateOrder.begin(); index != updateOrder.end(); ++index ) {
+		ScheduledModel& scheduled = scheduledModels[*index];
+
+		if ( selectedModels.empty() || estimatedCost + scheduled.costMilliseconds <= budgetMilliseconds ) {
+			selectedModels.push_back( *index );
+			estimatedCost += scheduled.costMilliseconds;
+		} else {
+			if ( scheduled.model->ExtrapolatePose( scheduled.pendingTime ) ) {
+				++stats.extrapolatedCount;
+			}
+			++stats.skippedCount;
+		}
+	}
+
+	std::vector<ScheduledModel>&	updateModels	= scheduledModels;
+	const std::vector<unsigned>&	selected		= selectedModels;
+	JobSystem::RangeTask updateTask = [&updateModels, &selected]( unsigned begin, unsigned end ) {
+		for ( unsigned i = begin; i < end; ++i ) {
+			ScheduledModel& scheduled = updateModels[selected[i]];
+
+			double startTime = GetTimeMilliseconds();
+			scheduled.model->Update( scheduled.pendingTime );
+			scheduled.lastCostMilliseconds = ( float )( GetTimeMilliseconds() - startTime );
+		}
+	};
+
+	if ( jobSystem != NULL ) {
+		jobSystem->ParallelFor( selectedModels.size(), 1, updateTask );
+	} else {
+		updateTask( 0, selectedModels.size() );
+	}
+
+	for ( std::vector<unsigned>::iterator index = selectedModels.begin(); index != selectedModels.end(); ++index ) {
+		ScheduledModel& scheduled = scheduledModels[*index];
+
+		if ( scheduled.costMilliseconds == 0.0f ) {
+			scheduled.costMilliseconds = scheduled.lastCostMilliseconds;
+		} else {
+			scheduled.costMilliseconds += ( scheduled.lastCostMilliseconds - scheduled.costMilliseconds ) * SCHEDULER_COST_SMOOTHING;
+		}
+
+		scheduled.pendingTime		= 0.0f;
+		stats.spentMilliseconds		+= scheduled.lastCostMilliseconds;
+	}
+
+	stats.updatedCount = selectedModels.size();
+}
@@ -0,0 +1,86 @@
+#ifndef __ANIMATIONSCHEDULER_H__
+#define __ANIMATIONSCHEDULER_H__
+
+#include "MD5Model.h"
+
+/*
+========================
+
+	AnimationSchedulerStats
+
+		What the scheduler did during the last frame.
+
+========================
+*/
+struct AnimationSchedulerStats {
+	unsigned	updatedCount;
+	unsigned	skippedCount;
+	unsigned	extrapolatedCount;
+	float		budgetMilliseconds;
+	float		spentMilliseconds;
+
+	AnimationSchedulerStats( void ) :
+		updatedCount( 0 ),
+		skippedCount( 0 ),
+		extrapolatedCount( 0 ),
+		budgetMilliseconds( 0.0f ),
+		spentMilliseconds( 0.0f )
+	{}
+};
+/*
+========================
+
+	AnimationScheduler
+
+		Spreads model updates across frames to fit
+		a per-frame CPU budget. Models are updated in
+		order of screen size times time since their last
+		update, the rest are extrapolated from their
+		last two evaluated poses.
+
+========================
+*/
+class AnimationScheduler {
+public:
+											~AnimationScheduler( void );
+
+	static AnimationScheduler*				CreateAnimationScheduler( float budgetMilliseconds );
+
+	void									AddModel( MD5Model* model );
+	void									RemoveModel( MD5Model* model );
+
+	void									Update( float dt, const glm::vec3& cameraPosition, float tanHalfFieldOfView, JobSystem* jobSystem );
+
+	inline void								SetBudget( float milliseconds ) { budgetMilliseconds = milliseconds; }
+	inline float							GetBudget( void ) const { return budgetMilliseconds; }
+	inline const AnimationSchedulerStats&	GetStats( void ) const { return stats; }
+
+private:
+	/*
+	========================
+
+		ScheduledModel
+
+			A model and its scheduling state.
+
+	========================
+	*/
+	struct ScheduledModel {
+		MD5Model*	model;
+		float		pendingTime;		//Time since the model was last updated
+		float		priority;
+		float		costMilliseconds;	//Running average of the update cost
+		float		lastCostMilliseconds;
+	};
+
+											AnimationScheduler( void );
+
+	std::vector<ScheduledModel>				scheduledModels;
+	std::vector<unsigned>					updateOrder;
+	std::vector<unsigned>					selectedModels;
+
+	float									budgetMilliseconds;
+	AnimationSchedulerStats					stats;
+};
+
+#endif //__ANIMATIONSCHEDULER_H__
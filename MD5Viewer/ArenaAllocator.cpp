@@ -0,0 +1,86 @@
+#include "ArenaAllocator.h"
+#include <cstdio>
+/*
+=============
+ArenaAllocator::ArenaAllocator
+
+	ArenaAllocator Constructor.
+	No memory is reserved until the first allocation.
+=============
+*/
+ArenaAllocator::ArenaAllocator( size_t blockSize ) :
+	currentBlock( 0 ),
+	blockSize( blockSize ),
+	usedBytes( 0 ),
+	reservedBytes( 0 )
+{}
+/*
+=============
+ArenaAllocator::~ArenaAllocator
+
+	ArenaAllocator Destructor.
+	Frees every block at once.
+=============
+*/
+ArenaAllocator::~ArenaAllocator( void ) {
+	for ( std::vector<ArenaBlock>::iterator block = blocks.begin();
+		  block != blocks.end(); ++block ) {
+		delete[] block->memory;
+	}
+	blocks.clear();
+}
+/*
+=============
+ArenaAllocator::Allocate
+
+	Returns bytes of memory aligned to alignment, a power of two.
+	Moves to the next block when the current one is full, blocks
+	are at least blockSize so large requests get a block of their own.
+	Returns NULL if the memory couldn't be allocated.
+=============
+*/
+void* ArenaAllocator::Allocate( size_t bytes, size_t alignment ) {
+	while ( currentBlock < blocks.size() ) {
+		ArenaBlock& block	= blocks[currentBlock];
+		size_t address		= reinterpret_cast<size_t>( block.memory ) + block.used;
+		size_t padding		= ( alignment - ( address & ( alignment - 1 ) ) ) & ( alignment - 1 );
+
+		if ( block.used + padding + bytes <= block.size ) {
+			block.used += padding + bytes;
+			usedBytes  += padding + bytes;
+			return block.memory + block.used - bytes;
+		}
+		++currentBlock;
+	}
+
+	ArenaBlock newBlock;
+	newBlock.size	= ( bytes + alignment > blockSize ) ? bytes + alignment : blockSize;
+	newBlock.used	= 0;
+	newBlock.memory	= new ( std::nothrow ) char[newBlock.size];
+	if ( newBlock.memory == NULL ) {
+		printf( "Arena could not allocate %u bytes\n", ( unsigned )newBlock.size );
+		return NULL;
+	}
+
+	blocks.push_back( newBlock );
+	reservedBytes += newBlock.size;
+	currentBlock = blocks.size() - 1;
+
+	return Allocate( bytes, alignment );
+}
+/*
+=============
+ArenaAllocator::Reset
+
+	Releases every allocation at once.
+	The blocks are kept for reuse.
+=============
+*/
+void ArenaAllocator::Reset( void ) {
+	for ( std::vector<ArenaBlock>::iterator block = blocks.begin();
+		  block != blocks.end(); ++block ) {
+		block->used = 0;
+	}
+	currentBlock	= 0;
+	usedBytes		= 0;
+}
@@ -0,0 +1,81 @@
+#ifndef __ARENAALLOCATOR_H__
+#define __ARENAALLOCATOR_H__
+
+#include <vector>
+#include <new>
+
+#define ARENA_DEFAULT_BLOCK_SIZE	( 1024 * 1024 )
+#define ARENA_DEFAULT_ALIGNMENT		16
+/*
+========================
+
+	ArenaAllocator
+
+		A bump allocator for short lived data.
+		Allocations are carved out of large blocks
+		and are all released at once by Reset or
+		when the arena is destroyed.
+		Destructors are never run, only use it for
+		types that don't own other memory.
+
+========================
+*/
+class ArenaAllocator {
+public:
+						ArenaAllocator( size_t blockSize = ARENA_DEFAULT_BLOCK_SIZE );
+						~ArenaAllocator( void );
+
+	void*				Allocate( size_t bytes, size_t alignment = ARENA_DEFAULT_ALIGNMENT );
+	void				Reset( void );
+
+	/*
+	=============
+	ArenaAllocator::AllocateArray
+
+		Allocates and default constructs count objects.
+		Returns NULL if the allocation failed.
+	=============
+	*/
+	template<typename T>
+	T* AllocateArray( size_t count ) {
+		T* objects = static_cast<T*>( Allocate( sizeof( T ) * count, __alignof( T ) > ARENA_DEFAULT_ALIGNMENT ? __alignof( T ) : ARENA_DEFAULT_ALIGNMENT ) );
+		if ( objects == NULL ) {
+			return NULL;
+		}
+		for ( size_t i = 0; i < count; ++i ) {
+			new ( &objects[i] ) T();
+		}
+		return objects;
+	}
+
+	inline size_t		GetUsedBytes( void ) const { return usedBytes; }
+	inline size_t		GetReservedBytes( void ) const { return reservedBytes; }
+
+private:
+	/*
+	========================
+
+		ArenaBlock
+
+			One block of the arena.
+
+	========================
+	*/
+	struct ArenaBlock {
+		char*	memory;
+		size_t	size;
+		size_t	used;
+	};
+
+	//Owns its blocks, not copyable
+						ArenaAllocator( const ArenaAllocator& );
+	ArenaAllocator&		operator=( const ArenaAllocator& );
+
+	std::vector<ArenaBlock>	blocks;
+	unsigned				currentBlock;
+	size_t					blockSize;
+	size_t					usedBytes;
+	size_t					reservedBytes;
+};
+
+#endif //__ARENAALLOCATOR_H__
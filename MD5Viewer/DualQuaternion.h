@@ -0,0 +1,116 @@
+#ifndef __DUALQUATERNION_H__
+#define __DUALQUATERNION_H__
+
+#include <glm\glm.hpp>
+#include <glm\gtc\quaternion.hpp>
+
+#define DUAL_QUATERNION_FLOATS	8	//Floats in a packed dual quaternion, real then dual part
+/*
+========================
+
+	DualQuaternion
+
+		A rigid transform as a unit rotation quaternion and
+		a dual part holding the translation, both stored as
+		xyz vector and w scalar so they pack straight into
+		the GPU palette. Blending them stays rigid, so twisted
+		joints don't collapse the way blended matricies do.
+		GPUDualQuaternionVertex.glsl does the same math as the
+		functions below.
+
+========================
+*/
+struct DualQuaternion {
+	glm::vec4	real;
+	glm::vec4	dual;
+
+	DualQuaternion( void ) :
+		real( 0.0f, 0.0f, 0.0f, 1.0f ),
+		dual( 0.0f, 0.0f, 0.0f, 0.0f )
+	{}
+};
+/*
+=============
+MultiplyQuaternions
+
+	Quaternion product of two xyzw vectors.
+=============
+*/
+inline glm::vec4 MultiplyQuaternions( const glm::vec4& a, const glm::vec4& b ) {
+	return glm::vec4( a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+					  a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+					  a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+					  a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z );
+}
+/*
+=============
+MakeSkinningDualQuaternion
+
+	Builds the dual quaternion taking a vertex from the bind
+	pose to the pose, the same transform as the joint matrix
+	times the inverse bind matrix.
+=============
+*/
+inline DualQuaternion MakeSkinningDualQuaternion( const glm::quat& poseOrientation, const glm::vec3& posePosition, const glm::quat& bindOrientation, const glm::vec3& bindPosition ) {
+	glm::quat rotation		= poseOrientation * glm::conjugate( bindOrientation );
+	glm::vec3 translation	= posePosition - ( rotation * bindPosition );
+
+	DualQuaternion skinning;
+	skinning.real = glm::vec4( rotation.x, rotation.y, rotation.z, rotation.w );
+	skinning.dual = MultiplyQuaternions( glm::vec4( translation, 0.0f ), skinning.real ) * 0.5f;
+	return skinning;
+}
+/*
+=============
+BlendDualQuaternions
+
+	Blends 4 palette entries by weight into a unit dual quaternion.
+	Entries on the other side of the first one's hemisphere are
+	negated so the blend takes the short way around.
+=============
+*/
+inline DualQuaternion BlendDualQuaternions( const DualQuaternion* palette, const unsigned short* bones, const glm::vec4& weights ) {
+	const glm::vec4& pivot = palette[bones[0]].real;
+
+	DualQuaternion blended;
+	blended.real = glm::vec4( 0.0f );
+	for ( unsigned i = 0; i < 4; ++i ) {
+		const DualQuaternion&	bone	= palette[bones[i]];
+		float					weight	= ( glm::dot( pivot, bone.real ) < 0.0f ) ? -weights[i] : weights[i];
+
+		blended.real += bone.real * weight;
+		blended.dual += bone.dual * weight;
+	}
+
+	float inverseLength = 1.0f / glm::length( blended.real );
+	blended.real *= inverseLength;
+	blended.dual *= inverseLength;
+	return blended;
+}
+/*
+=============
+DualQuaternionTransformPoint
+
+	Rotates then translates a point by a unit dual quaternion.
+=============
+*/
+inline glm::vec3 DualQuaternionTransformPoint( const DualQuaternion& transform, const glm::vec3& point ) {
+	glm::vec3 realVector	= glm::vec3( transform.real );
+	glm::vec3 dualVector	= glm::vec3( transform.dual );
+	glm::vec3 rotated		= point + 2.0f * glm::cross( realVector, glm::cross( realVector, point ) + transform.real.w * point );
+	glm::vec3 translation	= 2.0f * ( transform.real.w * dualVector - transform.dual.w * realVector + glm::cross( realVector, dualVector ) );
+	return rotated + translation;
+}
+/*
+=============
+DualQuaternionRotateVector
+
+	Rotates a direction by a unit dual quaternion, ignoring the translation.
+=============
+*/
+inline glm::vec3 DualQuaternionRotateVector( const DualQuaternion& transform, const glm::vec3& vector ) {
+	glm::vec3 realVector = glm::vec3( transform.real );
+	return vector + 2.0f * glm::cross( realVector, glm::cross( realVector, vector ) + transform.real.w * vector );
+}
+
+#endif //__DUALQUATERNION_H__
@@ -0,0 +1,267 @@
+#include "JobSystem.h"
+#include <cstdio>
+#include <algorithm>
+
+#if defined( _MSC_VER )
+#define JOB_THREAD_LOCAL __declspec( thread )
+#else
+#define JOB_THREAD_LOCAL __thread
+#endif
+
+//Which worker the current thread is, -1 for threads outside the pool
+static JOB_THREAD_LOCAL int currentWorkerIndex = -1;
+/*
+=============
+JobSystem::JobSystem
+
+	JobSystem Constructor.
+=============
+*/
+JobSystem::JobSystem( void ) {
+	queuedJobs	= 0;
+	nextQueue	= 0;
+	running		= true;
+}
+/*
+=============
+JobSystem::~JobSystem
+
+	JobSystem Destructor.
+	Stops the workers, unfinished jobs are dropped.
+=============
+*/
+JobSystem::~JobSystem( void ) {
+	{
+		std::lock_guard<std::mutex> guard( sleepLock );
+		running = false;
+	}
+	wakeCondition.notify_all();
+
+	for ( std::vector<std::thread>::iterator worker = workers.begin();
+		  worker != workers.end(); ++worker ) {
+		worker->join();
+	}
+	workers.clear();
+
+	for ( std::vector<WorkerQueue*>::iterator queue = queues.begin();
+		  queue != queues.end(); ++queue ) {
+		for ( std::deque<Job*>::iterator job = ( *queue )->jobs.begin();
+			  job != ( *queue )->jobs.end(); ++job ) {
+			delete *job;
+		}
+		delete *queue;
+	}
+	queues.clear();
+}
+/*
+=============
+JobSystem::CreateJobSystem
+
+	Creates a job system with threadCount workers.
+	0 uses one worker per hardware thread, leaving one for the caller.
+=============
+*/
+JobSystem* JobSystem::CreateJobSystem( unsigned threadCount ) {
+	JobSystem* jobSystem = new JobSystem();
+
+	if ( jobSystem == NULL || !jobSystem->InitWithThreads( threadCount ) ) {
+		delete jobSystem;
+		return NULL;
+	}
+
+	return jobSystem;
+}
+/*
+=============
+JobSystem::InitWithThreads
+
+	Creates the queues and starts the workers.
+=============
+*/
+bool JobSystem::InitWithThreads( unsigned threadCount ) {
+	if ( threadCount == 0 ) {
+		unsigned hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = ( hardwareThreads > 1 ) ? hardwareThreads - 1 : 0;
+	}
+
+	for ( unsigned i = 0; i <= threadCount; ++i ) {
+		queues.push_back( new WorkerQueue() );
+	}
+
+	for ( unsigned i = 0; i < threadCount; ++i ) {
+		workers.push_back( std::thread( &JobSystem::WorkerLoop, this, i ) );
+	}
+
+	printf( "Job system started with %i worker threads\n", threadCount );
+	return true;
+}
+/*
+=============
+JobSystem::Submit
+
+	Queues a task on the calling thread's queue.
+	The counter is decremented when the task finishes.
+=============
+*/
+void JobSystem::Submit( const Task& task, JobCounter& counter ) {
+	Job* job		= new Job();
+	job->task		= task;
+	job->counter	= &counter;
+
+	++counter.pending;
+
+	unsigned queueIndex = ( currentWorkerIndex > -1 ) ? ( unsigned )currentWorkerIndex : workers.size();
+	{
+		std::lock_guard<std::mutex> guard( queues[queueIndex]->lock );
+		queues[queueIndex]->jobs.push_back( job );
+	}
+
+	{
+		std::lock_guard<std::mutex> guard( sleepLock );
+		++queuedJobs;
+	}
+	wakeCondition.notify_one();
+}
+/*
+=============
+JobSystem::Wait
+
+	Runs queued jobs until the counter reaches zero.
+=============
+*/
+void JobSystem::Wait( JobCounter& counter ) {
+	unsigned queueIndex = ( currentWorkerIndex > -1 ) ? ( unsigned )currentWorkerIndex : workers.size();
+
+	while ( counter.pending > 0 ) {
+		if ( !TryRunJob( queueIndex ) ) {
+			std::this_thread::yield();
+		}
+	}
+}
+/*
+=============
+JobSystem::ParallelFor
+
+	Splits [0, count) into grainSize chunks and runs them across the workers.
+	Blocks until every chunk is done.
+=============
+*/
+void JobSystem::ParallelFor( unsigned count, unsigned grainSize, const RangeTask& task ) {
+	if ( grainSize == 0 ) {
+		grainSize = 1;
+	}
+
+	if ( workers.empty() || count <= grainSize ) {
+		task( 0, count );
+		return;
+	}
+
+	JobCounter counter;
+	for ( unsigned begin = 0; begin < count; begin += grainSize ) {
+		unsigned end = std::min( begin + grainSize, count );
+		Submit( [&task, begin, end]() { task( begin, end ); }, counter );
+	}
+
+	Wait( counter );
+}
+/*
+=============
+JobSystem::WorkerLoop
+
+	Runs jobs until the system shuts down.
+	Sleeps while there is nothing queued.
+=============
+*/
+void JobSystem::WorkerLoop( unsigned workerIndex ) {
+	currentWorkerIndex = ( int )workerIndex;
+
+	while ( running ) {
+		if ( !TryRunJob( workerIndex ) ) {
+			std::unique_lock<std::mutex> guard( sleepLock );
+			while ( running && queuedJobs <= 0 ) {
+				wakeCondition.wait( guard );
+			}
+		}
+	}
+}
+/*
+=============
+JobSystem::TryRunJob
+
+	Runs a job from the queue, or one stolen from another queue.
+	Returns false if there was nothing to run.
+=============
+*/
+bool JobSystem::TryRunJob( unsigned queueIndex ) {
+	Job* job = PopJob( queueIndex );
+	if ( job == NULL ) {
+		job = StealJob( queueIndex );
+	}
+	if ( job == NULL ) {
+		return false;
+	}
+
+	RunJob( job );
+	return true;
+}
+/*
+=============
+JobSystem::PopJob
+
+	Takes the newest job from a queue.
+=============
+*/
+JobSystem::Job* JobSystem::PopJob( unsigned queueIndex ) {
+	WorkerQueue* queue = queues[queueIndex];
+	std::lock_guard<std::mutex> guard( queue->lock );
+
+	if ( queue->jobs.empty() ) {
+		return NULL;
+	}
+
+	Job* job = queue->jobs.back();
+	queue->jobs.pop_back();
+	--queuedJobs;
+	return job;
+}
+/*
+=============
+JobSystem::StealJob
+
+	Takes the oldest job from another queue.
+=============
+*/
+JobSystem::Job* JobSystem::StealJob( unsigned thiefIndex ) {
+	unsigned queueCount = queues.size();
+	unsigned startIndex = ++nextQueue; //Spread thieves across the queues
+
+	for ( unsigned i = 0; i < queueCount; ++i ) {
+		unsigned queueIndex = ( startIndex + i ) % queueCount;
+		if ( queueIndex == thiefIndex ) {
+			continue;
+		}
+
+		WorkerQueue* queue = queues[queueIndex];
+		std::lock_guard<std::mutex> guard( queue->lock );
+		if ( !queue->jobs.empty() ) {
+			Job* job = queue->jobs.front();
+			queue->jobs.pop_front();
+			--queuedJobs;
+			return job;
+		}
+	}
+
+	return NULL;
+}
+/*
+=============
+JobSystem::RunJob
+
+	Runs a job and reports it done.
+=============
+*/
+void JobSystem::RunJob( Job* job ) {
+	job->task();
+	--job->counter->pending;
+	delete job;
+}
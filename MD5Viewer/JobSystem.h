@@ -0,0 +1,105 @@
+#ifndef __JOBSYSTEM_H__
+#define __JOBSYSTEM_H__
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+/*
+========================
+
+	JobCounter
+
+		Counts the jobs still running in a group.
+		Wait on it to block until the group is done.
+
+========================
+*/
+struct JobCounter {
+	std::atomic<int>	pending;
+
+	JobCounter( void ) {
+		pending = 0;
+	}
+};
+/*
+========================
+
+	JobSystem
+
+		A work stealing thread pool.
+		Each worker owns a queue and steals from the
+		others when it runs dry. Threads that wait on
+		a counter run queued jobs instead of blocking,
+		so jobs can submit and wait on other jobs.
+
+========================
+*/
+class JobSystem {
+public:
+	typedef std::function<void( void )>						Task;
+	typedef std::function<void( unsigned, unsigned )>		RangeTask;
+
+									~JobSystem( void );
+
+	static JobSystem*				CreateJobSystem( unsigned threadCount = 0 );
+
+	void							Submit( const Task& task, JobCounter& counter );
+	void							Wait( JobCounter& counter );
+	void							ParallelFor( unsigned count, unsigned grainSize, const RangeTask& task );
+
+	inline unsigned					GetThreadCount( void ) const { return workers.size(); }
+
+private:
+	/*
+	========================
+
+		Job
+
+			A queued task and the counter it reports to.
+
+	========================
+	*/
+	struct Job {
+		Task			task;
+		JobCounter*		counter;
+	};
+	/*
+	========================
+
+		WorkerQueue
+
+			A worker's queue.
+			The owner pops from the back, thieves take from the front.
+
+	========================
+	*/
+	struct WorkerQueue {
+		std::mutex			lock;
+		std::deque<Job*>	jobs;
+	};
+
+									JobSystem( void );
+
+	bool							InitWithThreads( unsigned threadCount );
+	void							WorkerLoop( unsigned workerIndex );
+	bool							TryRunJob( unsigned queueIndex );
+	Job*							PopJob( unsigned queueIndex );
+	Job*							StealJob( unsigned thiefIndex );
+	void							RunJob( Job* job );
+
+	std::vector<std::thread>		workers;
+	std::vector<WorkerQueue*>		queues;			//One per worker, plus one for outside threads
+
+	std::mutex						sleepLock;
+	std::condition_variable			wakeCondition;
+	std::atomic<int>				queuedJobs;
+	std::atomic<unsigned>			nextQueue;
+	std::atomic<bool>				running;
+};
+
+#endif //__JOBSYSTEM_H__
@@ -1,6 +1,7 @@
 #include "MD5Animation.h"
 #include "MD5FileOperations.h"
 #include <glm\gtc\matrix_transform.hpp>
+#include <algorithm>
 
 const std::string MD5Animation::DefaultAnimationName = "None";
 /*
@@ -11,15 +12,18 @@ MD5Animation::MD5Animation
 =============
 */
 MD5Animation::MD5Animation( void ) :
+	animationName( "NULL" ),
     numberOfFrames( 0 ),
     numberOfJoints( 0 ),
-    numberOfAnimatedComponents( 0 ),
     frameRate( 0 ),
+    numberOfAnimatedComponents( 0 ),
+	currentFrame( 0 ),
 	frameDuration( 0.0f ),
 	animationDuration( 0.0f ),
 	animTime( 0.0f ),
-	currentFrame( 0 ),
-	animationName( "NULL" )
+	playbackRate( 1.0f ),
+	wrapMode( ANIMATION_WRAP_LOOP ),
+	bakedJointCount( 0 )
 {}
 /*
 =============
@@ -35,14 +39,15 @@ MD5Animation::~MD5Animation( void )
 MD5Animation::CreateAnimationFromFile
 
 	Create an animation using the .md5anim at path.
+	Only the activeJoints are built if given.
     Returns an animation if successful, NULL if not.
 =============
 */
-MD5Animation* MD5Animation::CreateAnimationFromFile( const char* path ) {
+MD5Animation* MD5Animation::CreateAnimationFromFile( const char* path, const JointIndicies* activeJoints ) {
     MD5Animation* animation = new MD5Animation();
     
     if ( animation == NULL || 
-		 !animation->InitWithAnimationFromFile( path ) ) {
+		 !animation->InitWithAnimationFromFile( path, activeJoints ) ) {
         delete animation;
         return NULL;
     }
@@ -56,13 +61,14 @@ MD5Animation::InitWithAnimationFromFile
 	Initializes the Animation
 =============
 */
-bool MD5Animation::InitWithAnimationFromFile( const char* path ) {
+bool MD5Animation::InitWithAnimationFromFile( const char* path, const JointIndicies* activeJoints ) {
 
     if ( !ValidMD5AnimationExtension( path ) ) {
         return false;
     }
 
-	char* fileData = FileOperations::ReadFileToCharBuffer( path );
+	ArenaAllocator	loadArena; //Load temporaries, freed in one go when the load returns
+	char*			fileData = FileOperations::ReadFileToArena( path, loadArena );
 
 	if ( fileData == NULL ) { //File wasn't opened
 		printf( "Anim at path '%s' could not be opened\n", path );
@@ -70,6 +76,7 @@ bool MD5Animation::InitWithAnimationFromFile( const char* path ) {
 	} else {
 		printf( "Beginning load of: %s\n", path );
 
+		sourcePath		= path;
 		animationName   = path;
         unsigned slash  = animationName.find_last_of( "/" ) + 1;
         unsigned dot    = animationName.find_last_of( "." );
@@ -86,14 +93,13 @@ bool MD5Animation::InitWithAnimationFromFile( const char* path ) {
 				nextParam[2] = '\0'; //Truncate to 2 chars.
                  if ( !STRINGS_ARE_EQUAL( nextParam, "10" ) ) {
 					printf( "Only MD5Version 10 is supported\n" );
-					delete[] fileData;
 					return false;                
 				 }
             } else if ( STRINGS_ARE_EQUAL( currentParam, "numFrames" ) ) { //Read numFrames
                 numberOfFrames = std::atoi( nextParam );
-                frameData.resize( numberOfFrames );
 				frameBounds.resize( numberOfFrames );
 				skeletonList.resize( numberOfFrames );
+				AllocateFrameData();
             } else if ( STRINGS_ARE_EQUAL( currentParam, "numJoints" ) ) { //Read numJoints
                 numberOfJoints = std::atoi( nextParam );
 				jointInfo.resize( numberOfJoints );
@@ -102,42 +108,42 @@ bool MD5Animation::InitWithAnimationFromFile( const char* path ) {
                 frameRate = std::atoi( nextParam );
 			} else if ( STRINGS_ARE_EQUAL( currentParam, "numAnimatedComponents" ) ) { //Read numAnimatedComponents
                 numberOfAnimatedComponents = std::atoi( nextParam );
-				SetFrameDataSize( numberOfAnimatedComponents );					  
+				AllocateFrameData();
             } else if ( STRINGS_ARE_EQUAL( currentParam, "hierarchy" ) ) { //Read hierarchy
 				if ( jointInfo.size() == 0 ) {
                     printf( "numJoints was not specified\n" );
-	                delete[] fileData;
                     return false;
                 }
                 nextLineToken = ReadHierarchy( nextLineToken );
             } else if ( STRINGS_ARE_EQUAL( currentParam, "bounds" ) ) { //Read the bounds
                if ( frameBounds.size() == 0 ) {
                     printf( "numFrames was not specified\n" );
-	                delete[] fileData;
                     return false;
                 }
                 nextLineToken = ReadBounds( nextLineToken );
             } else if ( STRINGS_ARE_EQUAL( currentParam, "baseframe" ) ) { //Read the baseframe
                if ( frameBounds.size() == 0 ) {
                     printf( "numJoints was not specified\n" );
-	                delete[] fileData;
                     return false;
                 }
                 nextLineToken = ReadBaseFrame( nextLineToken );
             } else if ( STRINGS_ARE_EQUAL( currentParam, "frame" ) ) { //Read a frame
-               if ( frameData.size() == 0 ) {
+               if ( numberOfFrames == 0 ) {
                     printf( "numFrames was not specified\n" );
-	                delete[] fileData;
                     return false;
                 }
 				unsigned frameIndex = std::atoi( strtok_s( NULL, " ", &nextParam ) );
+				if ( frameIndex >= numberOfFrames ) {
+					printf( "Frame %u is out of range\n", frameIndex );
+					return false;
+				}
                 nextLineToken = ReadFrame( nextLineToken, frameIndex );
             }
 
 			currentLine = strtok_s( NULL, "\n", &nextLineToken );
 		}
 
-		BuildSkeletonFrames();
+		BuildSkeletonFrames( activeJoints );
 
 		frameDuration		= 1.0f / frameRate;
 		animationDuration	= frameDuration * numberOfFrames;
@@ -151,7 +157,6 @@ bool MD5Animation::InitWithAnimationFromFile( const char* path ) {
         printf( "Successfully Loaded MD5Anim: %s\n", path );       
 	}
 
-	delete[] fileData;
     return true;
 }
 /*
@@ -160,6 +165,7 @@ MD5Animation::Update
 
 	MD5Animation Update.
     Updates the skeleton frame.
+	Cost does not depend on delta, large steps jump straight to the new frame.
 =============
 */
 void MD5Animation::Update( float deltaTime ) {
@@ -167,38 +173,130 @@ void MD5Animation::Update( float deltaTime ) {
 		return;
 	}
 
-	animTime += deltaTime;
-	if ( animTime >= frameDuration ) {		
-        while ( animTime > frameDuration ) {
-            ++currentFrame;        
-		    animTime -= frameDuration;
-        
-		    if ( currentFrame >= numberOfFrames ) {
-			    currentFrame = 0;
-		    }
-        }
+	SetTime( animTime + deltaTime * playbackRate );
+
+	unsigned frame0 = 0;
+	unsigned frame1 = 0;
+	float interpolateAmount = 0.0f;
+	ComputeFramePair( animTime, wrapMode, frame0, frame1, interpolateAmount );
+
+	currentFrame = frame0;
+	InterpolateSkeletonFrames( skeletonList[frame0], skeletonList[frame1], currentSkeleton, interpolateAmount );
+}
+/*
+=============
+MD5Animation::SetTime
+
+	Sets the playback position in seconds.
+	Wraps or clamps the time depending on the wrap mode.
+=============
+*/
+void MD5Animation::SetTime( float newTime ) {
+	animTime = WrapTime( newTime );
+}
+/*
+=============
+MD5Animation::WrapTime
+
+	Wraps or clamps a time into the clip depending on the wrap mode.
+=============
+*/
+float MD5Animation::WrapTime( float time ) const {
+	if ( animationDuration <= 0.0f ) {
+		return 0.0f;
 	}
 
-	unsigned frame0 = currentFrame;
-	unsigned frame1 = currentFrame + 1;
-	if ( frame1 >= numberOfFrames ) {
-		frame1 = 0;
+	if ( wrapMode == ANIMATION_WRAP_LOOP ) {
+		float wrappedTime = fmodf( time, animationDuration );
+		if ( wrappedTime < 0.0f ) {
+			wrappedTime += animationDuration;
+		}
+		return wrappedTime;
 	}
-	float interpolateAmount = std::max( std::min( animTime / frameDuration, 1.0f ), 0.0f );
-	InterpolateSkeletonFrames( skeletonList[frame0], skeletonList[frame1], currentSkeleton, interpolateAmount );
+
+	return std::max( std::min( time, animationDuration - frameDuration ), 0.0f );
 }
 /*
 =============
-MD5Animation::SetFrameDataSize
+MD5Animation::ComputeFramePair
 
-	Sets the float array size in the frameData
+	Finds the two frames surrounding a time and how far between them it is.
+	Time is in seconds of clip time, playback rate is not applied.
+	Returns false if the clip has no frames.
 =============
 */
-void MD5Animation::SetFrameDataSize( unsigned size ) {
-	for ( FrameDataList::iterator currentFrame = frameData.begin();
-		  currentFrame != frameData.end(); ++currentFrame ) {
-		delete[] currentFrame->data;
-		currentFrame->data = new float[size];
+bool MD5Animation::ComputeFramePair( float timeSeconds, AnimationWrapMode mode, unsigned& frame0, unsigned& frame1, float& amount ) const {
+	if ( numberOfFrames == 0 ) {
+		return false;
+	}
+
+	frame0 = 0;
+	frame1 = 0;
+	amount = 0.0f;
+
+	if ( numberOfFrames < 2 || frameDuration <= 0.0f ) {
+		return true;
+	}
+
+	if ( mode == ANIMATION_WRAP_LOOP ) {
+		float clipTime = fmodf( timeSeconds, animationDuration );
+		if ( clipTime < 0.0f ) {
+			clipTime += animationDuration;
+		}
+
+		float framePosition = clipTime / frameDuration;
+		frame0 = std::min( ( unsigned )framePosition, numberOfFrames - 1 );
+		frame1 = ( frame0 + 1 < numberOfFrames ) ? frame0 + 1 : 0;
+		amount = framePosition - ( float )frame0;
+	} else {
+		float lastFrame		= ( float )( numberOfFrames - 1 );
+		float framePosition = std::max( std::min( timeSeconds / frameDuration, lastFrame ), 0.0f );
+		frame0 = std::min( ( unsigned )framePosition, numberOfFrames - 1 );
+		frame1 = std::min( frame0 + 1, numberOfFrames - 1 );
+		amount = framePosition - ( float )frame0;
+	}
+
+	amount = std::max( std::min( amount, 1.0f ), 0.0f );
+	return true;
+}
+/*
+=============
+MD5Animation::SamplePose
+
+	Samples a clip at a time without touching the clip's playback state.
+	Time is scaled by the playback rate then wrapped or clamped.
+	Store result in outPose.
+=============
+*/
+void MD5Animation::SamplePose( const MD5Animation& clip, float timeSeconds, Skeleton& outPose, AnimationWrapMode mode, float rate ) {
+	unsigned frame0 = 0;
+	unsigned frame1 = 0;
+	float amount	= 0.0f;
+
+	if ( !clip.ComputeFramePair( timeSeconds * rate, mode, frame0, frame1, amount ) ) {
+		return;
+	}
+
+	if ( outPose.joints.size() != clip.numberOfJoints ) {
+		outPose.joints.resize( clip.numberOfJoints );
+	}
+	if ( outPose.jointMatricies.size() != clip.numberOfJoints ) {
+		outPose.jointMatricies.resize( clip.numberOfJoints );
+	}
+
+	InterpolateSkeletonFrames( clip.skeletonList[frame0], clip.skeletonList[frame1], outPose, amount );
+}
+/*
+=============
+MD5Animation::AllocateFrameData
+
+	Allocates one buffer for every frame's animated
+	components once both counts are known.
+=============
+*/
+void MD5Animation::AllocateFrameData( void ) {
+	if ( numberOfFrames > 0 && numberOfAnimatedComponents > 0 ) {
+		frameData.Allocate( numberOfFrames, numberOfAnimatedComponents );
 	}
 }
 /*
@@ -318,7 +416,7 @@ MD5Animation::ReadFrame
 =============
 */
 char* MD5Animation::ReadFrame( char* startingPosition, unsigned frameIndex ) {
-	FrameData&	currentFrame	= frameData[frameIndex];
+	float*		currentFrame	= frameData.GetFrame( frameIndex );
 	char*		nextLine		= NULL;
 	char*		currentLine		= strtok_s( startingPosition, "\n", &nextLine );
 	char*		currentToken	= NULL;	
@@ -328,8 +426,8 @@ char* MD5Animation::ReadFrame( char* startingPosition, unsigned frameIndex ) {
 	while ( currentLine[0] != '}' ) {     
 		currentToken = strtok_s( currentLine, "\t", &nextToken );		
 		currentToken = strtok_s( currentToken, " ", &nextToken );
-		while ( currentToken != NULL ) {
-			currentFrame.data[dataIndex++] = ( float )std::atof( currentToken );
+		while ( currentToken != NULL && dataIndex < numberOfAnimatedComponents ) {
+			currentFrame[dataIndex++] = ( float )std::atof( currentToken );
 			currentToken = strtok_s( NULL, " ", &nextToken );
 		}
 		currentLine = strtok_s( NULL, "\n", &nextLine );
@@ -342,23 +440,30 @@ char* MD5Animation::ReadFrame( char* startingPosition, unsigned frameIndex ) {
 MD5Animation::BuildSkeletonFrames
 
 	Builds the skeletons for all the frames.
+	If activeJoints is given only those joints are built,
+	it must be sorted and contain the parents of every joint in it.
 =============
 */
-void MD5Animation::BuildSkeletonFrames( void ) {
+void MD5Animation::BuildSkeletonFrames( const JointIndicies* activeJoints ) {
 	BaseFrameJoint*	baseJoint			= NULL;
 	Skeleton*		skeletonFrame		= NULL;
-	float*			curFrameData		= NULL;
-	unsigned		currentJointIndex	= 0;
+	const float*	curFrameData		= NULL;
+	unsigned		jointCount			= ( activeJoints ) ? activeJoints->size() : numberOfJoints;
 	glm::vec3		rotatedPosition;
 
 	for ( unsigned currentFrame = 0; currentFrame < numberOfFrames; ++currentFrame ) { //Each frame
-		curFrameData	= frameData[currentFrame].data; 
+		curFrameData	= frameData.GetFrame( currentFrame ); 
 		skeletonFrame	= &skeletonList[currentFrame];
 		
         skeletonFrame->joints.resize( numberOfJoints );
 
-		for ( JointInfoList::iterator currentJointInfo = jointInfo.begin();
-			  currentJointInfo != jointInfo.end(); ++currentJointInfo ) { //Each joint
+		for ( unsigned activeIndex = 0; activeIndex < jointCount; ++activeIndex ) { //Each joint
+			unsigned currentJointIndex = ( activeJoints ) ? ( *activeJoints )[activeIndex] : activeIndex;
+			if ( currentJointIndex >= numberOfJoints ) {
+				continue;
+			}
+
+			const JointInfo* currentJointInfo = &jointInfo[currentJointIndex];
 			baseJoint = &baseFrameJoints[currentJointIndex];
 			unsigned dataOffset = 0;
 			
@@ -397,10 +502,7 @@ void MD5Animation::BuildSkeletonFrames( void ) {
 				currentSkeletonJoint.position		= parent.position + rotatedPosition;
                 currentSkeletonJoint.orientation	= glm::normalize( parent.orientation * currentSkeletonJoint.orientation );	
 			}
-			
-            ++currentJointIndex;			
 		}		
-		currentJointIndex	= 0;		
 	}
 
 	currentSkeleton.joints.resize( numberOfJoints );		 //Enough joints for the skeleton used in the animation 
@@ -422,6 +524,7 @@ MD5Animation::SetCurrentFrame
 void MD5Animation::SetCurrentFrame( unsigned newFrame ) {
 	if ( newFrame < numberOfFrames ) {
 		currentFrame = newFrame;
+		animTime	 = frameDuration * newFrame;
 	}
 }
 /*
@@ -430,13 +533,16 @@ MD5Animation::InterpolateSkeletonFrames
 
 	Blends between 2 skeleton frames.
 	Store result in destination skeleton.
+	Only the activeJoints are blended if given.
 =============
 */
-void MD5Animation::InterpolateSkeletonFrames( const Skeleton& s1, const Skeleton& s2, Skeleton& destination, float amount ) {
-	unsigned numberOfJoints         = s1.joints.size();
+void MD5Animation::InterpolateSkeletonFrames( const Skeleton& s1, const Skeleton& s2, Skeleton& destination, float amount, const JointIndicies* activeJoints ) {
+	unsigned numberOfJoints         = ( activeJoints ) ? activeJoints->size() : s1.joints.size();
     glm::mat4 boneTranslationMatrix = glm::mat4( 1.0 );
 
-	for ( unsigned i = 0; i < numberOfJoints; i++ ) {
+	for ( unsigned activeIndex = 0; activeIndex < numberOfJoints; activeIndex++ ) {
+		unsigned i = ( activeJoints ) ? ( *activeJoints )[activeIndex] : activeIndex;
+
 		SkeletonJoint&  goalJoint	= destination.joints[i];
 		glm::mat4&      goalMatrix  = destination.jointMatricies[i];
 
@@ -455,6 +561,331 @@ void MD5Animation::InterpolateSkeletonFrames( const Skeleton& s1, const Skeleton
 	}
 }
 /*
+========================
+
+	BlendSample
+
+		A blend input resolved to its frame pair.
+
+========================
+*/
+struct BlendSample {
+	const Skeleton*		frame0;
+	const Skeleton*		frame1;
+	const Skeleton*		reference;
+	const BoneMask*		mask;
+	float				amount;
+	float				weight;
+	bool				additive;
+};
+/*
+=============
+SampleBlendJoint
+
+	Interpolates a single joint of a resolved blend input.
+=============
+*/
+static inline void SampleBlendJoint( const BlendSample& sample, unsigned joint, glm::vec3& position, glm::quat& orientation ) {
+	const SkeletonJoint& joint1 = sample.frame0->joints[joint];
+	const SkeletonJoint& joint2 = sample.frame1->joints[joint];
+
+	position	= joint1.position + ( sample.amount * ( joint2.position - joint1.position ) );
+	orientation = glm::slerp( joint1.orientation, joint2.orientation, sample.amount );
+}
+/*
+=============
+ToLocalJoint
+
+	Moves a model space position and orientation into its parent's space.
+=============
+*/
+static inline void ToLocalJoint( const SkeletonJoint& parent, glm::vec3& position, glm::quat& orientation ) {
+	glm::quat inverseOrientation = glm::conjugate( parent.orientation );
+
+	position	= inverseOrientation * ( position - parent.position );
+	orientation	= glm::normalize( inverseOrientation * orientation );
+}
+/*
+=============
+ToModelJoint
+
+	Moves a joint from its parent's space back into model space.
+=============
+*/
+static inline void ToModelJoint( const SkeletonJoint& parent, SkeletonJoint& joint ) {
+	joint.position		= parent.position + ( parent.orientation * joint.position );
+	joint.orientation	= glm::normalize( parent.orientation * joint.orientation );
+}
+/*
+=============
+SampleLocalBlendJoint
+
+	Interpolates a single joint of a resolved blend input
+	and returns it relative to its interpolated parent.
+=============
+*/
+static inline void SampleLocalBlendJoint( const BlendSample& sample, unsigned joint, glm::vec3& position, glm::quat& orientation ) {
+	SampleBlendJoint( sample, joint, position, orientation );
+
+	int parentID = sample.frame0->joints[joint].parentID;
+	if ( parentID > -1 ) {
+		SkeletonJoint parent;
+		SampleBlendJoint( sample, parentID, parent.position, parent.orientation );
+		ToLocalJoint( parent, position, orientation );
+	}
+}
+/*
+=============
+ApplyAdditiveJoint
+
+	Adds the difference between a sampled joint and the
+	clip's reference frame onto a joint.
+	Works in parent space so children follow the rotation
+	their parents pick up.
+=============
+*/
+static inline void ApplyAdditiveJoint( const BlendSample& sample, unsigned joint, glm::vec3& localPosition, glm::quat& localOrientation ) {
+	const SkeletonJoint& reference = sample.reference->joints[joint];
+	glm::vec3 referencePosition		= reference.position;
+	glm::quat referenceOrientation	= reference.orientation;
+	glm::vec3 samplePosition;
+	glm::quat sampleOrientation;
+
+	if ( reference.parentID > -1 ) {
+		ToLocalJoint( sample.reference->joints[reference.parentID], referencePosition, referenceOrientation );
+	}
+	SampleLocalBlendJoint( sample, joint, samplePosition, sampleOrientation );
+
+	glm::quat deltaOrientation = sampleOrientation * glm::conjugate( referenceOrientation );
+	localPosition		+= ( samplePosition - referencePosition ) * sample.weight;
+	localOrientation	= glm::normalize( glm::slerp( glm::quat(), deltaOrientation, sample.weight ) * localOrientation );
+}
+/*
+=============
+RemoveMismatchedSamples
+
+	Drops resolved inputs whose clip doesn't have numberOfJoints
+	joints, their joint indicies don't line up with the base.
+	Returns how many are left.
+=============
+*/
+static unsigned RemoveMismatchedSamples( const BlendSample* samples, unsigned* sampleIndicies, unsigned count, unsigned numberOfJoints ) {
+	unsigned kept = 0;
+	for ( unsigned i = 0; i < count; ++i ) {
+		if ( samples[sampleIndicies[i]].frame0->joints.size() == numberOfJoints ) {
+			sampleIndicies[kept++] = sampleIndicies[i];
+		}
+	}
+	return kept;
+}
+/*
+=============
+ComputeJointMatrix
+
+	Builds the joint matrix from a joint's position and orientation.
+=============
+*/
+static inline void ComputeJointMatrix( const SkeletonJoint& joint, glm::mat4& matrix ) {
+	matrix			= glm::toMat4( joint.orientation );
+	matrix[3][0]	= joint.position.x;
+	matrix[3][1]	= joint.position.y;
+	matrix[3][2]	= joint.position.z;
+}
+/*
+=============
+MD5Animation::EvaluateBlend
+
+	Blends any number of clips into the destination skeleton.
+	Each input is sampled per joint while blending so no
+	intermediate skeletons or matricies are built.
+	Full body base inputs are weighted together in model space.
+	Additive and masked inputs are layered on top in parent space,
+	masked ones in order and only visiting the joints in their mask,
+	then the joints are moved back to model space. A masked subtree
+	stays attached to the base pose's unmasked ancestors and joints
+	below the mask follow it. Inputs whose clip has a different
+	number of joints than the first base input are skipped.
+	Only the first MAX_BLEND_INPUTS are used.
+	If activeJoints is given only those joints are visited, it
+	must be sorted and contain the parents of every joint in it.
+=============
+*/
+void MD5Animation::EvaluateBlend( const AnimationBlendInputs& inputs, Skeleton& destination, const JointIndicies* activeJoints ) {
+	BlendSample	samples[MAX_BLEND_INPUTS];
+	unsigned	baseSamples[MAX_BLEND_INPUTS];
+	unsigned	additiveSamples[MAX_BLEND_INPUTS];
+	unsigned	maskedSamples[MAX_BLEND_INPUTS];
+	unsigned	sampleCount		= 0;
+	unsigned	baseCount		= 0;
+	unsigned	additiveCount	= 0;
+	unsigned	maskedCount		= 0;
+	float		totalWeight		= 0.0f;
+
+	//Resolve the frame pair for each input once
+	for ( AnimationBlendInputs::const_iterator input = inputs.begin();
+		  input != inputs.end() && sampleCount < MAX_BLEND_INPUTS; ++input ) {
+		const MD5Animation* clip = input->clip;
+		BlendSample& sample = samples[sampleCount];
+		unsigned frame0 = 0;
+		unsigned frame1 = 0;
+
+		if ( clip == NULL || input->weight <= 0.0f ||
+			 ( input->mask != NULL && input->mask->empty() ) ||
+			 !clip->ComputeFramePair( input->time, clip->wrapMode, frame0, frame1, sample.amount ) ) {
+			continue;
+		}
+
+		sample.frame0		= &clip->skeletonList[frame0];
+		sample.frame1		= &clip->skeletonList[frame1];
+		sample.reference	= &clip->skeletonList[0];
+		sample.mask			= input->mask;
+		sample.weight		= input->weight;
+		sample.additive		= input->additive;
+
+		if ( sample.mask != NULL ) {
+			sample.weight = std::min( sample.weight, 1.0f );
+			maskedSamples[maskedCount++] = sampleCount;
+		} else if ( sample.additive ) {
+			additiveSamples[additiveCount++] = sampleCount;
+		} else {
+			baseSamples[baseCount++] = sampleCount;
+		}
+		++sampleCount;
+	}
+
+	if ( baseCount == 0 ) {
+		return;
+	}
+
+	unsigned numberOfJoints = samples[baseSamples[0]].frame0->joints.size();
+	baseCount		= RemoveMismatchedSamples( samples, baseSamples, baseCount, numberOfJoints );
+	additiveCount	= RemoveMismatchedSamples( samples, additiveSamples, additiveCount, numberOfJoints );
+	maskedCount		= RemoveMismatchedSamples( samples, maskedSamples, maskedCount, numberOfJoints );
+
+	for ( unsigned input = 0; input < baseCount; ++input ) {
+		totalWeight += samples[baseSamples[input]].weight;
+	}
+	if ( totalWeight <= 0.0f ) {
+		return;
+	}
+
+	if ( destination.joints.size() != numberOfJoints ) {
+		destination.joints.resize( numberOfJoints );
+	}
+	if ( destination.jointMatricies.size() != numberOfJoints ) {
+		destination.jointMatricies.resize( numberOfJoints );
+	}
+
+	float		inverseTotalWeight	= 1.0f / totalWeight;
+	unsigned	jointCount			= ( activeJoints ) ? activeJoints->size() : numberOfJoints;
+	bool		layered				= ( additiveCount > 0 || maskedCount > 0 );
+
+	for ( unsigned activeIndex = 0; activeIndex < jointCount; ++activeIndex ) {
+		unsigned i = ( activeJoints ) ? ( *activeJoints )[activeIndex] : activeIndex;
+		if ( i >= numberOfJoints ) {
+			continue;
+		}
+
+		SkeletonJoint&	goalJoint	= destination.joints[i];
+		glm::vec3		position	= glm::vec3( 0.0f );
+		glm::quat		orientation = glm::quat( 0.0f, 0.0f, 0.0f, 0.0f );
+		glm::vec3		samplePosition;
+		glm::quat		sampleOrientation;
+
+		for ( unsigned input = 0; input < baseCount; ++input ) {
+			const BlendSample& sample = samples[baseSamples[input]];
+			float weight = sample.weight * inverseTotalWeight;
+
+			SampleBlendJoint( sample, i, samplePosition, sampleOrientation );
+			if ( input > 0 && glm::dot( orientation, sampleOrientation ) < 0.0f ) {
+				sampleOrientation = -sampleOrientation; //Keep every sample in the same hemisphere
+			}
+
+			position	+= samplePosition * weight;
+			orientation += sampleOrientation * weight;
+		}
+		orientation = glm::normalize( orientation );
+
+		goalJoint.parentID		= samples[baseSamples[0]].frame0->joints[i].parentID;
+		goalJoint.position		= position;
+		goalJoint.orientation	= orientation;
+
+		if ( !layered ) {
+			ComputeJointMatrix( goalJoint, destination.jointMatricies[i] );
+		}
+	}
+
+	if ( layered ) {
+		//Children before parents so every parent is still in model space
+		for ( unsigned activeIndex = jointCount; activeIndex-- > 0; ) {
+			unsigned i = ( activeJoints ) ? ( *activeJoints )[activeIndex] : activeIndex;
+			if ( i >= numberOfJoints ) {
+				continue;
+			}
+
+			SkeletonJoint& goalJoint = destination.joints[i];
+			if ( goalJoint.parentID > -1 ) {
+				ToLocalJoint( destination.joints[goalJoint.parentID], goalJoint.position, goalJoint.orientation );
+			}
+
+			for ( unsigned input = 0; input < additiveCount; ++input ) {
+				ApplyAdditiveJoint( samples[additiveSamples[input]], i, goalJoint.position, goalJoint.orientation );
+			}
+		}
+
+		//Masked layers only cost as much as the joints they cover
+		for ( unsigned input = 0; input < maskedCount; ++input ) {
+			const BlendSample& sample = samples[maskedSamples[input]];
+
+			for ( BoneMask::const_iterator joint = sample.mask->begin();
+				  joint != sample.mask->end(); ++joint ) {
+				if ( *joint >= numberOfJoints || ( activeJoints && !std::binary_search( activeJoints->begin(), activeJoints->end(), *joint ) ) ) {
+					continue;
+				}
+
+				SkeletonJoint& goalJoint = destination.joints[*joint];
+
+				if ( sample.additive ) {
+					ApplyAdditiveJoint( sample, *joint, goalJoint.position, goalJoint.orientation );
+				} else {
+					glm::vec3 samplePosition;
+					glm::quat sampleOrientation;
+					SampleLocalBlendJoint( sample, *joint, samplePosition, sampleOrientation );
+
+					goalJoint.position		= glm::mix( goalJoint.position, samplePosition, sample.weight );
+					goalJoint.orientation	= glm::slerp( goalJoint.orientation, sampleOrientation, sample.weight );
+				}
+			}
+		}
+
+		//Parents before children so every parent is back in model space
+		for ( unsigned activeIndex = 0; activeIndex < jointCount; ++activeIndex ) {
+			unsigned i = ( activeJoints ) ? ( *activeJoints )[activeIndex] : activeIndex;
+			if ( i >= numberOfJoints ) {
+				continue;
+			}
+
+			SkeletonJoint& goalJoint = destination.joints[i];
+			if ( goalJoint.parentID > -1 ) {
+				ToModelJoint( destination.joints[goalJoint.parentID], goalJoint );
+			}
+
+			ComputeJointMatrix( goalJoint, destination.jointMatricies[i] );
+		}
+	}
+}
+/*
+=============
+MD5Animation::BuildBoneMask
+
+	Builds a bone mask from a joint in this animation's hierarchy.
+	Returns false if there is no joint with that name.
+=============
+*/
+bool MD5Animation::BuildBoneMask( const char* jointName, bool includeChildren, BoneMask& mask ) const {
+	return BuildBoneMaskFromJoints( jointInfo, jointName, includeChildren, mask );
+}
+/*
 =============
 MD5Animation::ComputeQuaternionW
  
@@ -481,4 +912,96 @@ bool MD5Animation::ValidMD5AnimationExtension( const char* path ) {
 
     return ( pathStr.length() > 7 &&
              pathStr.substr( pathStr.length() - 7, 7 ).compare( "md5anim" ) == 0 );
-}
\ No newline at end of file
+}
+/*
+=============
+MD5Animation::BakePalettes
+
+	Stores every frame's skinning matricies, joint times inverse bind,
+	packed as 3x4 in palette order. Sampling a baked clip only has to
+	interpolate two palettes. Trades memory for CPU time.
+	The joints must have been built by BuildSkeletonFrames,
+	activeJoints must be sorted.
+=============
+*/
+bool MD5Animation::BakePalettes( const JointIndicies& activeJoints, const std::vector<glm::mat4>& inverseBindMatricies ) {
+	if ( skeletonList.empty() || inverseBindMatricies.size() < numberOfJoints ||
+		 ( !activeJoints.empty() && activeJoints.back() >= numberOfJoints ) ) {
+		printf( "Animation '%s' can't be baked\n", animationName.c_str() );
+		return false;
+	}
+
+	bakedJointCount = activeJoints.size();
+	bakedPalettes.assign( skeletonList.size() * bakedJointCount * PALETTE_MATRIX_FLOATS, 0.0f );
+
+	float*		palette = ( bakedPalettes.empty() ) ? NULL : &bakedPalettes[0];
+	glm::mat4	jointMatrix;
+	for ( SkeletonList::iterator frame = skeletonList.begin(); frame != skeletonList.end(); ++frame ) {
+		for ( JointIndicies::const_iterator joint = activeJoints.begin(); joint != activeJoints.end(); ++joint ) {
+			ComputeJointMatrix( frame->joints[*joint], jointMatrix ); //Keyframes only keep joints, not matricies
+			PackPaletteMatrix( jointMatrix * inverseBindMatricies[*joint], palette );
+			palette += PALETTE_MATRIX_FLOATS;
+		}
+	}
+
+	return true;
+}
+/*
+=============
+MD5Animation::GetMemoryUsage
+
+	Returns the memory held by the clip.
+	Clips only live in CPU memory.
+=============
+*/
+MemoryUsage MD5Animation::GetMemoryUsage( void ) const {
+	size_t cpuBytes = sizeof( MD5Animation ) + frameData.GetMemory() + VectorMemory( jointInfo ) +
+					  VectorMemory( frameBounds ) + VectorMemory( baseFrameJoints ) + VectorMemory( skeletonList ) +
+					  SkeletonMemory( currentSkeleton ) + VectorMemory( bakedPalettes );
+
+	for ( SkeletonList::const_iterator skeleton = skeletonList.begin();
+		  skeleton != skeletonList.end(); ++skeleton ) {
+		cpuBytes += SkeletonMemory( *skeleton );
+	}
+
+	return MemoryUsage( cpuBytes, 0 );
+}
+/*
+=============
+MD5Animation::ReleaseBakedPalettes
+
+	Frees the baked palettes.
+=============
+*/
+void MD5Animation::ReleaseBakedPalettes( void ) {
+	std::vector<float>().swap( bakedPalettes );
+	bakedJointCount = 0;
+}
+/*
+=============
+MD5Animation::SampleBakedPalette
+
+	Interpolates the baked palettes around a time into destination,
+	which holds GetBakedJointCount() packed matricies.
+	Returns false if the clip isn't baked.
+=============
+*/
+bool MD5Animation::SampleBakedPalette( float timeSeconds, float* destination ) const {
+	unsigned	frame0	= 0;
+	unsigned	frame1	= 0;
+	float		amount	= 0.0f;
+
+	if ( bakedPalettes.empty() || !ComputeFramePair( timeSeconds, wrapMode, frame0, frame1, amount ) ) {
+		return false;
+	}
+
+	unsigned		paletteSize = bakedJointCount * PALETTE_MATRIX_FLOATS;
+	const float*	palette0	= &bakedPalettes[frame0 * paletteSize];
+	const float*	palette1	= &bakedPalettes[frame1 * paletteSize];
+
+	for ( unsigned i = 0; i < paletteSize; ++i ) {
+		destination[i] = palette0[i] + ( palette1[i] - palette0[i] ) * amount;
+	}
+
+	return true;
+}
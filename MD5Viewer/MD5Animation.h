@@ -10,10 +10,16 @@
 #define QUATERNION_Y	0x10
 #define QUATERNION_Z	0x20
 
+#define MAX_BLEND_INPUTS	16
+
 #include <GL\glew.h>
 #include <fstream>
 
 #include "MD5AnimationStructs.h"
+#include "MemoryReport.h"
+
+struct AnimationBlendInput;
+typedef std::vector<AnimationBlendInput> AnimationBlendInputs;
 
 /*
 ========================
@@ -30,25 +36,54 @@ public:
 
 								~MD5Animation( void );
 
-    static MD5Animation*		CreateAnimationFromFile( const char* path );
+    static MD5Animation*		CreateAnimationFromFile( const char* path, const JointIndicies* activeJoints = NULL );
 
     void						Update( float delta );
-	void						BuildSkeletonFrames( void );
-	static void					InterpolateSkeletonFrames( const Skeleton& skeleton1, const Skeleton& skeleton2, Skeleton& destination, float amount );
+	void						BuildSkeletonFrames( const JointIndicies* activeJoints = NULL );
+	static void					InterpolateSkeletonFrames( const Skeleton& skeleton1, const Skeleton& skeleton2, Skeleton& destination, float amount, const JointIndicies* activeJoints = NULL );
+	static void					SamplePose( const MD5Animation& clip, float timeSeconds, Skeleton& outPose, AnimationWrapMode wrapMode = ANIMATION_WRAP_LOOP, float playbackRate = 1.0f );
+	static void					EvaluateBlend( const AnimationBlendInputs& inputs, Skeleton& destination, const JointIndicies* activeJoints = NULL );
+
+	bool						ComputeFramePair( float timeSeconds, AnimationWrapMode wrapMode, unsigned& frame0, unsigned& frame1, float& amount ) const;
 
 	inline const Skeleton&		GetCurrentSkeleton( void ) { return currentSkeleton; }
 	
 	void						SetCurrentFrame( unsigned newFrame );
+	void						SetTime( float newTime );
+	float						WrapTime( float time ) const;
+	inline float				GetTime( void ) const { return animTime; }
+
+	inline void					SetPlaybackRate( float rate ) { playbackRate = rate; }
+	inline float				GetPlaybackRate( void ) const { return playbackRate; }
+	inline void					SetWrapMode( AnimationWrapMode mode ) { wrapMode = mode; }
+	inline AnimationWrapMode	GetWrapMode( void ) const { return wrapMode; }
+
+	inline float				GetDuration( void ) const { return animationDuration; }
+	inline unsigned				GetFrameCount( void ) const { return numberOfFrames; }
+	inline unsigned				GetJointCount( void ) const { return numberOfJoints; }
+	bool						BuildBoneMask( const char* jointName, bool includeChildren, BoneMask& mask ) const;
 	const std::string&			GetAnimationName( void ) const { return animationName; }
+	const std::string&			GetSourcePath( void ) const { return sourcePath; }
+
+	bool						BakePalettes( const JointIndicies& activeJoints, const std::vector<glm::mat4>& inverseBindMatricies );
+	void						ReleaseBakedPalettes( void );
+	bool						SampleBakedPalette( float timeSeconds, float* destination ) const;
+	inline bool					HasBakedPalettes( void ) const { return !bakedPalettes.empty(); }
+	inline const std::vector<float>& GetBakedPalettes( void ) const { return bakedPalettes; }
+	inline unsigned				GetFrameRate( void ) const { return frameRate; }
+	inline unsigned				GetBakedJointCount( void ) const { return bakedJointCount; }
+	inline unsigned				GetBakedPaletteMemory( void ) const { return bakedPalettes.capacity() * sizeof( float ); }
+
+	MemoryUsage					GetMemoryUsage( void ) const;
 
 private:
 								MD5Animation( void );
 
-    bool						InitWithAnimationFromFile( const char* path );
+    bool						InitWithAnimationFromFile( const char* path, const JointIndicies* activeJoints );
 
     static bool					ValidMD5AnimationExtension( const char* path );
 
-	void						SetFrameDataSize( unsigned size );
+	void						AllocateFrameData( void );
 	
 	char*						ReadHierarchy( char* startingPosition );
 	char*						ReadBounds( char* startingPosition );
@@ -62,6 +97,7 @@ private:
 	void						ComputeQuaternionW( glm::quat& quaternion );
 
 	std::string					animationName;
+	std::string					sourcePath;
 
     unsigned int				numberOfFrames;
     unsigned int				numberOfJoints;
@@ -71,15 +107,57 @@ private:
 
 	float						frameDuration;
 	float						animationDuration;
-	float						animTime;
+	float						animTime;		//Playback position within the clip in seconds
+	float						playbackRate;
+
+	AnimationWrapMode			wrapMode;
 
-	FrameDataList				frameData;
+	FrameDataBuffer				frameData;
 	JointInfoList				jointInfo;
 	Bounds						frameBounds;
 	BaseFrameJoints				baseFrameJoints;
 	SkeletonList				skeletonList;
 	Skeleton					currentSkeleton;
+
+	std::vector<float>			bakedPalettes;		//Packed skinning matricies, frame * joint * PALETTE_MATRIX_FLOATS
+	unsigned					bakedJointCount;
 };
 typedef std::vector<MD5Animation*> MD5Animations;
+/*
+========================
+
+	AnimationBlendInput
+
+		A clip sampled at a time with a weight.
+		Additive inputs are applied on top of the
+		weighted base pose as the difference from
+		the clip's first frame.
+		Masked inputs only touch the joints in their mask.
+
+========================
+*/
+struct AnimationBlendInput {
+	const MD5Animation*	clip;
+	const BoneMask*		mask;
+	float				time;
+	float				weight;
+	bool				additive;
+
+	AnimationBlendInput( void ) :
+		clip( NULL ),
+		mask( NULL ),
+		time( 0.0f ),
+		weight( 0.0f ),
+		additive( false )
+	{}
+
+	AnimationBlendInput( const MD5Animation* clip, float time, float weight, bool additive = false, const BoneMask* mask = NULL ) :
+		clip( clip ),
+		mask( mask ),
+		time( time ),
+		weight( weight ),
+		additive( additive )
+	{}
+};
 
 #endif //__MD5ANIMATION_H__
\ No newline at end of file
@@ -3,10 +3,15 @@
 
 #include <string>
 #include <vector>
+#include <cstring>
 #include <glm\glm.hpp>
 #include <glm\gtc\quaternion.hpp>
 #include <glm\gtx\quaternion.hpp>
 
+enum AnimationWrapMode {
+	ANIMATION_WRAP_LOOP,
+	ANIMATION_WRAP_CLAMP
+};
 /*
 ========================
 
@@ -68,29 +73,92 @@ struct BaseFrameJoint {
 	{}
 };
 typedef std::vector<BaseFrameJoint> BaseFrameJoints;
+#define FRAME_DATA_ALIGNMENT	16	//Bytes, every frame starts on this boundary
 /*
 ========================
 
-	FrameData
+	FrameDataBuffer
 
-		Data for a single frame.
+		The animated components of every frame
+		in one aligned allocation, frame major.
+		Frames are padded to the alignment so each
+		one starts aligned. Holds no pointers into
+		itself so the block can be moved or mapped.
 
 ========================
 */
-struct FrameData {
-	unsigned    index;
-	float*      data;
-
-	FrameData( void ) :
-		index( 0 ),
-		data( NULL )
+struct FrameDataBuffer {
+	FrameDataBuffer( void ) :
+		rawData( NULL ),
+		data( NULL ),
+		frameCount( 0 ),
+		componentCount( 0 ),
+		frameStride( 0 )
 	{}
 
-	~FrameData( void ) {
-		delete[] data;
+	~FrameDataBuffer( void ) {
+		Free();
+	}
+
+	/*
+	=============
+	FrameDataBuffer::Allocate
+
+		Allocates zeroed space for frames * components floats.
+	=============
+	*/
+	void Allocate( unsigned frames, unsigned components ) {
+		const unsigned floatsPerAlignment = FRAME_DATA_ALIGNMENT / sizeof( float );
+
+		Free();
+		frameCount		= frames;
+		componentCount	= components;
+		frameStride		= ( ( components + floatsPerAlignment - 1 ) / floatsPerAlignment ) * floatsPerAlignment;
+
+		size_t bytes = sizeof( float ) * frameStride * frameCount;
+		if ( bytes == 0 ) {
+			return;
+		}
+
+		rawData = new char[bytes + FRAME_DATA_ALIGNMENT - 1];
+		data	= reinterpret_cast<float*>( ( reinterpret_cast<size_t>( rawData ) + FRAME_DATA_ALIGNMENT - 1 ) & ~( size_t )( FRAME_DATA_ALIGNMENT - 1 ) );
+		memset( data, 0, bytes );
 	}
+
+	/*
+	=============
+	FrameDataBuffer::Free
+
+		Releases the buffer.
+	=============
+	*/
+	void Free( void ) {
+		delete[] rawData;
+		rawData			= NULL;
+		data			= NULL;
+		frameCount		= 0;
+		componentCount	= 0;
+		frameStride		= 0;
+	}
+
+	inline float*		GetFrame( unsigned frame ) { return data + frame * frameStride; }
+	inline const float*	GetFrame( unsigned frame ) const { return data + frame * frameStride; }
+	inline bool			IsAllocated( void ) const { return data != NULL; }
+	inline unsigned		GetFrameCount( void ) const { return frameCount; }
+	inline unsigned		GetComponentCount( void ) const { return componentCount; }
+	inline size_t		GetMemory( void ) const { return sizeof( float ) * frameStride * frameCount; }
+
+private:
+	//Owns the allocation, not copyable
+						FrameDataBuffer( const FrameDataBuffer& );
+	FrameDataBuffer&	operator=( const FrameDataBuffer& );
+
+	char*		rawData;
+	float*		data;
+	unsigned	frameCount;
+	unsigned	componentCount;
+	unsigned	frameStride;	//Floats from one frame to the next
 };
-typedef std::vector<FrameData> FrameDataList;
 /*
 ========================
 
@@ -129,5 +197,72 @@ struct Skeleton {
 };
 typedef std::vector<Skeleton> SkeletonList;
 
+typedef std::vector<unsigned>	JointIndicies;
+typedef JointIndicies			BoneMask;	//Sorted indicies of the joints a layer affects
+/*
+=============
+BuildBoneMaskFromJoints
+
+	Fills mask with the joint called rootName.
+	Also adds all of its descendants if includeChildren is set.
+	Works on any joint list with name and parentID, parents must come before children.
+	Returns false if no joint has that name.
+=============
+*/
+template<typename JointList>
+bool BuildBoneMaskFromJoints( const JointList& jointList, const char* rootName, bool includeChildren, BoneMask& mask ) {
+	std::vector<bool> inMask( jointList.size(), false );
+	bool foundRoot = false;
+
+	mask.clear();
+	for ( unsigned i = 0; i < jointList.size(); ++i ) {
+		int parentID = jointList[i].parentID;
+
+		if ( !foundRoot && jointList[i].name.compare( rootName ) == 0 ) {
+			foundRoot = true;
+			inMask[i] = true;
+		} else if ( includeChildren && parentID > -1 && inMask[parentID] ) {
+			inMask[i] = true;
+		}
+
+		if ( inMask[i] ) {
+			mask.push_back( i );
+		}
+	}
+
+	return foundRoot;
+}
+
+#define PALETTE_MATRIX_FLOATS	12	//Floats in a packed 3x4 skinning matrix
+/*
+=============
+PackPaletteMatrix
+
+	Stores the top three rows of an affine matrix, one row per 4 floats,
+	so a shader can skin with three dot products per bone.
+=============
+*/
+inline void PackPaletteMatrix( const glm::mat4& matrix, float* destination ) {
+	for ( unsigned row = 0; row < 3; ++row ) {
+		for ( unsigned column = 0; column < 4; ++column ) {
+			destination[row * 4 + column] = matrix[column][row];
+		}
+	}
+}
+/*
+=============
+UnpackPaletteMatrix
+
+	Expands a packed 3x4 skinning matrix back to a 4x4 matrix.
+=============
+*/
+inline void UnpackPaletteMatrix( const float* source, glm::mat4& matrix ) {
+	for ( unsigned column = 0; column < 4; ++column ) {
+		matrix[column][0] = source[column];
+		matrix[column][1] = source[4 + column];
+		matrix[column][2] = source[8 + column];
+		matrix[column][3] = ( column == 3 ) ? 1.0f : 0.0f;
+	}
+}
 
 #endif //__MD5ANIMATIONSTRUCTS_H__
\ No newline at end of file
@@ -4,30 +4,33 @@
 #include <glm\glm.hpp>
 #include <glm\gtc\quaternion.hpp>
 #include <string>
+#include "ArenaAllocator.h"
 
 class FileOperations {
 public:
 	/*
 	=============
-	FileOperations::ReadFileToCharBuffer
+	FileOperations::ReadFileToArena
 
-		Reads a file at a specified path into a char buffer.
-		You are responsible for freeing the char buffer.
+		Reads a file at a specified path into a null terminated
+		char buffer allocated from arena.
+		The buffer is freed with the arena.
 		Returns NULL if there was a problem opening the file.
 	=============
 	*/
-	static char* ReadFileToCharBuffer( const char* path ) {
+	static char* ReadFileToArena( const char* path, ArenaAllocator& arena ) {
 		std::ifstream file;
 		file.open( path, std::ios_base::in | std::ios_base::binary );
 		char* fileData = NULL;
 		if ( file.good() ) {
-			//Read the whole file at once!
-			//Like a boss
 			file.seekg( 0, std::ios::end );
 			unsigned fileSize = ( unsigned )file.tellg();
-			fileData = new char[fileSize];
-			file.seekg( 0, std::ios::beg );
-			file.read( fileData, fileSize );
+			fileData = static_cast<char*>( arena.Allocate( fileSize + 1, 1 ) );
+			if ( fileData != NULL ) {
+				file.seekg( 0, std::ios::beg );
+				file.read( fileData, fileSize );
+				fileData[fileSize] = '\0';
+			}
 		} else {
 			printf( "Could not open file: %s", path );
 		}
@@ -1,6 +1,8 @@
 #include "MD5Mesh.h"
 #include "MD5FileOperations.h"
+#include <glm\gtc\packing.hpp>
 #include <algorithm>
+#include <cstddef>
 /*
 =============
 MD5Mesh::MD5Mesh
@@ -10,15 +12,21 @@ MD5Mesh::MD5Mesh
 */
 MD5Mesh::MD5Mesh( void ) :
 	shaderName( "NULL" ),
-	vertexData( NULL ),
-	indexBuffer( NULL ),
+	skinnedVertexData( NULL ),
+	skinnedDataPending( false ),
 	diffuseTexture( NULL ),
-    vboName( 0 ),
+	dynamicVboName( 0 ),
+	staticVboName( 0 ),
+	bindVboName( 0 ),
+	boneIndexVboName( 0 ),
+	boneIndexType( GL_UNSIGNED_BYTE ),
     iboName( 0 ),
     cpuVaoName( 0 ),
     gpuVaoName( 0 ),
 	indexCount( 0 ),
-    triangleCount( 0 )
+    triangleCount( 0 ),
+	vertexCount( 0 ),
+	bindPoseRadius( 0.0f )
 {}
 /*
 =============
@@ -28,14 +36,16 @@ MD5Mesh::~MD5Mesh
 =============
 */
 MD5Mesh::~MD5Mesh( void ) {    
-    glDeleteBuffers( 1, &vboName );
+    glDeleteBuffers( 1, &dynamicVboName );
+    glDeleteBuffers( 1, &staticVboName );
+    glDeleteBuffers( 1, &bindVboName );
+    glDeleteBuffers( 1, &boneIndexVboName );
     glDeleteBuffers( 1, &iboName );
     glDeleteVertexArrays( 1, &cpuVaoName );
     glDeleteVertexArrays( 1, &gpuVaoName );
 
 	delete diffuseTexture;
-	delete vertexData;
-	delete indexBuffer;
+	delete[] skinnedVertexData;
 }
 /*
 =============
@@ -44,13 +54,14 @@ MD5Mesh::CreateMeshFromData
 	Return an MD5Mesh from a byte stream if successful.
 	NULL if not successful.	
 	Fills end position with the address of where the buffer should continue reading.
+	Load temporaries are allocated from loadArena.
 =============
 */
-MD5Mesh* MD5Mesh::CreateMeshFromData( char* data, const Joints& jointData, char** endPosition ) {
+MD5Mesh* MD5Mesh::CreateMeshFromData( char* data, const Joints& jointData, char** endPosition, ArenaAllocator& loadArena ) {
 	MD5Mesh* mesh = new MD5Mesh();
 	
 	if ( mesh == NULL ||
-		 !mesh->InitWithData( data, jointData, endPosition ) ) {
+		 !mesh->InitWithData( data, jointData, endPosition, loadArena ) ) {
 		delete mesh;
 		return NULL;
 	}
@@ -59,12 +70,40 @@ MD5Mesh* MD5Mesh::CreateMeshFromData( char* data, const Joints& jointData, char*
 }
 /*
 =============
-MD5Mesh::LoadFromData
+MD5Mesh::InitWithData
 
-	Render the mesh with the appropriate diffuse map.
+	Reads the mesh and uploads it to OpenGL.
+=============
+*/
+bool MD5Mesh::InitWithData( char* startingPosition, const Joints& jointInfo, char** endPosition, ArenaAllocator& loadArena ) {
+	Triangle*		triangles	= NULL; //Only needed until the index buffer is built
+	VertexBindData*	bindData	= NULL;
+
+	if ( !ParseMeshData( startingPosition, endPosition, loadArena, &triangles, &bindData ) ) {
+		return false;
+	}
+
+	BuildBindPose( jointInfo, triangles, bindData, loadArena );    
+
+	printf( "   Loaded mesh component\n" );
+	printf( "      Vertex count:\t%i\n", vertexCount );
+	printf( "      Triangle count:\t%i\n", triangleCount );
+	printf( "      Weights count:\t%i\n", weightJoints.size() );
+
+	return true;
+}
+/*
+=============
+MD5Mesh::ParseMeshData
+
+	Reads the verticies, weights and triangles of a mesh block.
+	The triangles and vertex bind data are allocated from loadArena.
+	Fills end position with the address of where the buffer should continue reading.
 =============
 */
-bool MD5Mesh::InitWithData( char* startingPosition, const Joints& jointInfo, char** endPosition ) {
+bool MD5Mesh::ParseMeshData( char* startingPosition, char** endPosition, ArenaAllocator& loadArena, Triangle** trianglesOut, VertexBindData** bindDataOut ) {
+	Triangle*		triangles	= NULL;
+	VertexBindData*	bindData	= NULL;
 	char* nextLine      = NULL;
 	char* currentLine   = strtok_s( startingPosition, "\n", &nextLine );
 	char* junk          = NULL;
@@ -81,29 +120,32 @@ bool MD5Mesh::InitWithData( char* startingPosition, const Joints& jointInfo, cha
 			shaderName.append( ".tga" );
 		} else if ( STRINGS_ARE_EQUAL( currentToken, "numverts" ) ) {
 			int numVerticies = std::atoi( strtok_s( NULL, " ", &nextToken ) );
-			verticies.resize( numVerticies );
+			weightRanges.resize( numVerticies );
+			jointNormals.assign( numVerticies, glm::vec3( 0.0f ) );
+			bindData = loadArena.AllocateArray<VertexBindData>( numVerticies );
 		} else if ( STRINGS_ARE_EQUAL( currentToken, "vert" ) ) {
-			if ( verticies.size() > 0 ) {
-				ReadVertex( nextToken );
+			if ( bindData != NULL && weightRanges.size() > 0 ) {
+				ReadVertex( nextToken, bindData );
 			} else {
 				printf( "Can't load verticies. No numverts was specified\n" );
 				return false;
 			}
 		} else if ( STRINGS_ARE_EQUAL( currentToken, "numtris" ) ) {
-			int numTris = std::atoi( strtok_s( NULL, " ", &nextToken ) );
-			triangles.resize( numTris );
+			triangleCount	= std::atoi( strtok_s( NULL, " ", &nextToken ) );
+			triangles		= loadArena.AllocateArray<Triangle>( triangleCount );
 		} else if ( STRINGS_ARE_EQUAL( currentToken, "tri" ) ) {
-			if ( triangles.size() > 0 ) {
-				ReadTriangle( nextToken );
+			if ( triangles != NULL && triangleCount > 0 ) {
+				ReadTriangle( nextToken, triangles );
 			} else {
 				printf( "Can't load triangles. No numtris was specified\n" );
 				return false;
 			}
 		} else if ( STRINGS_ARE_EQUAL( currentToken, "numweights" ) ) {
 			int numWeights = std::atoi( strtok_s( NULL, " ", &nextToken ) );
-			weights.resize( numWeights );
+			weightPositions.assign( numWeights, glm::vec4( 0.0f ) );
+			weightJoints.assign( numWeights, 0 );
 		} else if ( STRINGS_ARE_EQUAL( currentToken, "weight" ) ) {
-			if (weights.size() > 0 ) {
+			if ( weightJoints.size() > 0 ) {
 				ReadWeight( nextToken );
 			} else {
 				printf( "Can't load weights. No numweights was specified\n" );
@@ -114,82 +156,495 @@ bool MD5Mesh::InitWithData( char* startingPosition, const Joints& jointInfo, cha
 		currentLine = strtok_s( NULL, "\n", &nextLine );
 	}
 
-	BuildBindPose( jointInfo );    
+	if ( triangles == NULL || bindData == NULL ) {
+		printf( "Mesh has no numtris or numverts\n" );
+		return false;
+	}
 
-	printf( "   Loaded mesh component\n" );
-	printf( "      Vertex count:\t%i\n", verticies.size() );
-	printf( "      Triangle count:\t%i\n", triangles.size() );
-	printf( "      Weights count:\t%i\n", weights.size() );
+	//The skinning kernel trusts the weight ranges
+	for ( unsigned vertexIndex = 0; vertexIndex < weightRanges.size(); ++vertexIndex ) {
+		if ( weightRanges[vertexIndex].startWeight + weightRanges[vertexIndex].countWeight > weightJoints.size() ) {
+			printf( "Vertex %u uses weights past the end of the mesh\n", vertexIndex );
+			return false;
+		}
+	}
+
+	for ( unsigned triangleIndex = 0; triangleIndex < triangleCount; ++triangleIndex ) {
+		for ( unsigned i = 0; i < 3; ++i ) {
+			if ( triangles[triangleIndex].indices[i] >= weightRanges.size() ) {
+				printf( "Triangle %u uses vertex %u which is out of range\n", triangleIndex, triangles[triangleIndex].indices[i] );
+				return false;
+			}
+		}
+	}
 
+	SortVerticiesByWeightCount( triangles, bindData, loadArena );
+
+	*trianglesOut	= triangles;
+	*bindDataOut	= bindData;
 	*endPosition = nextLine;
 	return true;
 }
 /*
 =============
-MD5Mesh::ApplySkeleton
+MD5Mesh::SortVerticiesByWeightCount
+
+	Reorders the verticies so ones with the same number of weights
+	are next to each other and records each run as a bucket.
+	The triangles are remapped to the new order and every vertex's
+	weights are laid out in vertex order.
+	The sort is stable so the same mesh block always gives the
+	same order, RestoreCPUData relies on this.
+=============
+*/
+void MD5Mesh::SortVerticiesByWeightCount( Triangle* triangles, VertexBindData* bindData, ArenaAllocator& loadArena ) {
+	unsigned			count			= weightRanges.size();
+	unsigned*			sortedOrder		= loadArena.AllocateArray<unsigned>( count );	//New index to old index
+	unsigned*			remap			= loadArena.AllocateArray<unsigned>( count );	//Old index to new index
+	VertexBindData*		sortedBindData	= loadArena.AllocateArray<VertexBindData>( count );
+	const VertexWeightRanges& ranges	= weightRanges;
+
+	for ( unsigned vertexIndex = 0; vertexIndex < count; ++vertexIndex ) {
+		sortedOrder[vertexIndex] = vertexIndex;
+	}
+	std::stable_sort( sortedOrder, sortedOrder + count, [&ranges]( unsigned a, unsigned b ) {
+		return ranges[a].countWeight < ranges[b].countWeight;
+	} );
+
+	VertexWeightRanges		sortedRanges( count );
+	std::vector<glm::vec4>	sortedPositions;
+	std::vector<unsigned>	sortedJoints;
+	sortedPositions.reserve( weightPositions.size() );
+	sortedJoints.reserve( weightJoints.size() );
+
+	weightBuckets.clear();
+	for ( unsigned vertexIndex = 0; vertexIndex < count; ++vertexIndex ) {
+		unsigned					oldIndex	= sortedOrder[vertexIndex];
+		const VertexWeightRange&	oldRange	= weightRanges[oldIndex];
+
+		remap[oldIndex]				= vertexIndex;
+		sortedBindData[vertexIndex]	= bindData[oldIndex];
+
+		sortedRanges[vertexIndex].startWeight = sortedJoints.size();
+		sortedRanges[vertexIndex].countWeight = oldRange.countWeight;
+		sortedPositions.insert( sortedPositions.end(), weightPositions.begin() + oldRange.startWeight, weightPositions.begin() + oldRange.startWeight + oldRange.countWeight );
+		sortedJoints.insert( sortedJoints.end(), weightJoints.begin() + oldRange.startWeight, weightJoints.begin() + oldRange.startWeight + oldRange.countWeight );
+
+		if ( weightBuckets.empty() || weightBuckets.back().countWeight != oldRange.countWeight ) {
+			VertexWeightBucket bucket;
+			bucket.firstVertex = vertexIndex;
+			bucket.countWeight = oldRange.countWeight;
+			weightBuckets.push_back( bucket );
+		}
+		++weightBuckets.back().vertexCount;
+	}
+
+	for ( unsigned triangleIndex = 0; triangleIndex < triangleCount; ++triangleIndex ) {
+		for ( unsigned i = 0; i < 3; ++i ) {
+			triangles[triangleIndex].indices[i] = remap[triangles[triangleIndex].indices[i]];
+		}
+	}
+
+	std::copy( sortedBindData, sortedBindData + count, bindData );
+	weightRanges.swap( sortedRanges );
+	weightPositions.swap( sortedPositions );
+	weightJoints.swap( sortedJoints );
+}
+/*
+=============
+MD5Mesh::ReleaseCPUData
 
-	Applys a skeleton to the mesh.
-	Updates the VBO position and normal values.
+	Frees everything only CPU skinning needs once the mesh is on the GPU.
+	The joint influences, bone joints and radius are kept so the
+	joint pruning and LOD code keep working.
 =============
 */
-void MD5Mesh::ApplySkeleton( const Skeleton& skeleton ) {
-	unsigned	vertexIndex = 0;
-	float		newValues[6];
+void MD5Mesh::ReleaseCPUData( void ) {
+	delete[] skinnedVertexData;
+	skinnedVertexData	= NULL;
+	skinnedDataPending	= false;
+
+	VertexWeightRanges().swap( weightRanges );
+	VertexWeightBuckets().swap( weightBuckets );
+	std::vector<glm::vec3>().swap( jointNormals );
+	std::vector<glm::vec4>().swap( weightPositions );
+	std::vector<unsigned>().swap( weightJoints );
+	std::vector<glm::vec4>().swap( bindPositions );
+	std::vector<glm::vec4>().swap( bindNormals );
+	std::vector<glm::vec4>().swap( boneWeights );
+}
+/*
+=============
+MD5Mesh::RestoreCPUData
 
-    glBindBuffer( GL_ARRAY_BUFFER, vboName );
+	Reads the CPU side data back from the mesh block it was loaded from.
+	The OpenGL buffers are left alone.
+	Returns false if the data doesn't match the uploaded mesh.
+=============
+*/
+bool MD5Mesh::RestoreCPUData( char* startingPosition, const Joints& jointInfo, char** endPosition, ArenaAllocator& loadArena ) {
+	Triangle*		triangles	= NULL;
+	VertexBindData*	bindData	= NULL;
 
-	for ( Verticies::iterator vertex = verticies.begin();
-		  vertex != verticies.end(); ++vertex ) {
- 
-		glm::vec3 vertexPosition	= glm::vec3( 0.0f );
-		glm::vec3 vertexNormal		= glm::vec3( 0.0f );
+	ReleaseCPUData();
+	if ( !ParseMeshData( startingPosition, endPosition, loadArena, &triangles, &bindData ) ) {
+		return false;
+	}
 
-		unsigned weightStart = vertex->startWeight;
-		unsigned weightCount = vertex->countWeight;
-		
-		//Calculate position using all weights
-		for ( unsigned i = 0; i < weightCount; i++ ) {            
-			const Weight&			currentWeight	= weights[weightStart + i];
-			const SkeletonJoint&	currentJoint	= skeleton.joints[currentWeight.joint];
+	if ( weightRanges.size() != vertexCount ) {
+		printf( "Mesh has %u verticies, %u were uploaded\n", ( unsigned )weightRanges.size(), vertexCount );
+		ReleaseCPUData();
+		return false;
+	}
 
-			glm::vec3 weightedVertex = currentJoint.orientation * currentWeight.position;
-			vertexPosition += ( ( currentJoint.position + weightedVertex ) * currentWeight.bias );
-			vertexNormal += ( ( currentJoint.orientation * vertex->jointNormal ) * currentWeight.bias );
+	skinnedVertexData					= new float[vertexCount * DYNAMIC_VERTEX_FLOATS];
+	PackedStaticVertex*	staticStream	= loadArena.AllocateArray<PackedStaticVertex>( vertexCount ); //Already on the GPU
+
+	ComputeVerticies( jointInfo, bindData, staticStream, loadArena );
+	ComputeNormals( jointInfo, triangles, bindData );
+	BuildPaletteStreams( bindData, staticStream );
+
+	return true;
+}
+/*
+=============
+MD5Mesh::GetCPUMemory
+
+	Returns the bytes of CPU memory the mesh is holding.
+=============
+*/
+unsigned MD5Mesh::GetCPUMemory( void ) const {
+	unsigned memory = weightRanges.capacity() * sizeof( VertexWeightRange ) + weightBuckets.capacity() * sizeof( VertexWeightBucket ) + jointNormals.capacity() * sizeof( glm::vec3 ) +
+					  weightPositions.capacity() * sizeof( glm::vec4 ) + weightJoints.capacity() * sizeof( unsigned ) +
+					  ( bindPositions.capacity() + bindNormals.capacity() + boneWeights.capacity() ) * sizeof( glm::vec4 ) +
+					  jointInfluences.capacity() * sizeof( MeshJointInfluence ) + boneJoints.capacity() * sizeof( unsigned short );
+
+	if ( skinnedVertexData != NULL ) {
+		memory += vertexCount * DYNAMIC_VERTEX_FLOATS * sizeof( float );
+	}
+
+	return memory;
+}
+/*
+=============
+MD5Mesh::SkinVerticies
+
+	Skins the mesh with a skeleton on the CPU.
+	Only writes to skinnedVertexData, no OpenGL calls are made
+	so this is safe to run off the render thread.
+	UploadSkinnedVerticies publishes the result.
+	Only the weight ranges, joint normals, weights and the
+	skeleton's joint matricies are read.
+=============
+*/
+void MD5Mesh::SkinVerticies( const Skeleton& skeleton ) {
+	SkinVertexRange( skeleton, 0, vertexCount );
+	FinishSkinning();
+}
+/*
+=============
+MD5Mesh::SkinVerticiesPalette
+
+	Skins the mesh on the CPU the way the GPU does, from the
+	top 4 bone weights of each vertex and a palette of joint
+	matricies times inverse bind matricies indexed by joint.
+	Like SkinVerticies no OpenGL calls are made.
+=============
+*/
+void MD5Mesh::SkinVerticiesPalette( const glm::mat4* palette ) {
+	SkinVertexRangePalette( palette, 0, vertexCount );
+	FinishSkinning();
+}
+/*
+=============
+MD5Mesh::SkinVerticiesDualQuaternion
+
+	Skins the mesh on the CPU the way the GPU dual quaternion
+	shader does, from the top 4 bone weights of each vertex
+	and a palette of dual quaternions indexed by joint.
+=============
+*/
+void MD5Mesh::SkinVerticiesDualQuaternion( const DualQuaternion* palette ) {
+	SkinVertexRangeDualQuaternion( palette, 0, vertexCount );
+	FinishSkinning();
+}
+/*
+=============
+MD5Mesh::SkinVertexRange
+
+	Skins count verticies from firstVertex with every weight.
+	Each vertex only writes its own part of skinnedVertexData,
+	so ranges that don't overlap can be skinned on different
+	threads at once. Call FinishSkinning once every range is done.
+=============
+*/
+void MD5Mesh::SkinVertexRange( const Skeleton& skeleton, unsigned firstVertex, unsigned count ) {
+	if ( skinnedVertexData == NULL || weightJoints.empty() || skeleton.jointMatricies.empty() || firstVertex >= vertexCount ) {
+		return; //Released or nothing to skin
+	}
+
+	SkinningStreams		streams		= GetSkinningStreams();
+	unsigned			lastVertex	= firstVertex + std::min( count, vertexCount - firstVertex );
+
+	//Each bucket's verticies have the same weight count so they get a kernel with no per vertex branching
+	for ( VertexWeightBuckets::const_iterator bucket = weightBuckets.begin();
+		  bucket != weightBuckets.end(); ++bucket ) {
+		unsigned bucketFirst	= std::max( firstVertex, bucket->firstVertex );
+		unsigned bucketLast		= std::min( lastVertex, bucket->firstVertex + bucket->vertexCount );
+		if ( bucketFirst < bucketLast ) {
+			SkinningKernel::SkinVerticiesBucket( streams, &skeleton.jointMatricies[0], bucket->countWeight, bucketFirst, bucketLast - bucketFirst, skinnedVertexData );
 		}
+	}
+}
+/*
+=============
+MD5Mesh::SkinVertexRangePalette
+
+	Skins count verticies from firstVertex from the 4 bone palette.
+	Thread safe for ranges that don't overlap like SkinVertexRange.
+=============
+*/
+void MD5Mesh::SkinVertexRangePalette( const glm::mat4* palette, unsigned firstVertex, unsigned count ) {
+	if ( skinnedVertexData == NULL || boneWeights.empty() || firstVertex >= vertexCount ) {
+		return; //Released or nothing to skin
+	}
+
+	SkinningKernel::SkinVerticiesPalette( GetPaletteStreams(), palette, firstVertex, std::min( count, vertexCount - firstVertex ), skinnedVertexData );
+}
+/*
+=============
+MD5Mesh::SkinVertexRangeDualQuaternion
+
+	Skins count verticies from firstVertex from the 4 bone
+	dual quaternion palette.
+	Thread safe for ranges that don't overlap like SkinVertexRange.
+=============
+*/
+void MD5Mesh::SkinVertexRangeDualQuaternion( const DualQuaternion* palette, unsigned firstVertex, unsigned count ) {
+	if ( skinnedVertexData == NULL || boneWeights.empty() || firstVertex >= vertexCount ) {
+		return; //Released or nothing to skin
+	}
+
+	SkinningKernel::SkinVerticiesDualQuaternion( GetPaletteStreams(), palette, firstVertex, std::min( count, vertexCount - firstVertex ), skinnedVertexData );
+}
+/*
+=============
+MD5Mesh::FinishSkinning
+
+	Flags the skinned verticies for UploadSkinnedVerticies
+	after every vertex range has been skinned.
+=============
+*/
+void MD5Mesh::FinishSkinning( void ) {
+	if ( skinnedVertexData != NULL ) {
+		skinnedDataPending = true;
+	}
+}
+/*
+=============
+MD5Mesh::MeasurePaletteError
+
+	Skins the mesh both ways into scratch buffers and compares the positions.
+	Every weight is skinned with the scalar reference kernel, so the
+	error doesn't depend on which SIMD kernel is built in.
+	Adds the distance of every vertex to totalError and keeps the largest in maxError.
+	Returns the number of verticies measured.
+=============
+*/
+unsigned MD5Mesh::MeasurePaletteError( const Skeleton& skeleton, const glm::mat4* palette, float& maxError, float& totalError ) const {
+	if ( skinnedVertexData == NULL || weightJoints.empty() || boneWeights.empty() || skeleton.jointMatricies.empty() ) {
+		return 0;
+	}
 
-		memcpy( &newValues[0], &vertexPosition[0], sizeof( float ) * 3 ); //Vertex Position
-		memcpy( &newValues[3], &vertexNormal[0]  , sizeof( float ) * 3 ); //Vertex Normal
+	std::vector<float> allWeights( vertexCount * DYNAMIC_VERTEX_FLOATS );
+	std::vector<float> paletteWeights( vertexCount * DYNAMIC_VERTEX_FLOATS );
+	SkinningKernel::SkinVerticiesScalar( GetSkinningStreams(), &skeleton.jointMatricies[0], 0, vertexCount, &allWeights[0] );
+	SkinningKernel::SkinVerticiesPalette( GetPaletteStreams(), palette, 0, vertexCount, &paletteWeights[0] );
 
-        glBufferSubData( GL_ARRAY_BUFFER, sizeof( float ) * 16 * vertexIndex, sizeof( float ) * 6, &newValues[0] );
+	for ( unsigned vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex ) {
+		const float* expected	= &allWeights[vertexIndex * DYNAMIC_VERTEX_FLOATS];
+		const float* actual		= &paletteWeights[vertexIndex * DYNAMIC_VERTEX_FLOATS];
 
-        ++vertexIndex;
+		float error = glm::length( glm::vec3( actual[0], actual[1], actual[2] ) - glm::vec3( expected[0], expected[1], expected[2] ) );
+		maxError	= std::max( maxError, error );
+		totalError	+= error;
 	}
 
+	return vertexCount;
+}
+/*
+=============
+MD5Mesh::GetSkinningStreams
+
+	Points the skinning streams at the mesh's arrays.
+=============
+*/
+SkinningStreams MD5Mesh::GetSkinningStreams( void ) const {
+	SkinningStreams streams;
+	streams.weightRanges	= &weightRanges[0];
+	streams.jointNormals	= &jointNormals[0];
+	streams.weightPositions	= &weightPositions[0];
+	streams.weightJoints	= &weightJoints[0];
+	return streams;
+}
+/*
+=============
+MD5Mesh::GetPaletteStreams
+
+	Points the palette skinning streams at the mesh's arrays.
+=============
+*/
+PaletteSkinningStreams MD5Mesh::GetPaletteStreams( void ) const {
+	PaletteSkinningStreams streams;
+	streams.bindPositions	= &bindPositions[0];
+	streams.bindNormals		= &bindNormals[0];
+	streams.boneWeights		= &boneWeights[0];
+	streams.boneJoints		= &boneJoints[0];
+	return streams;
+}
+/*
+=============
+MD5Mesh::UploadSkinnedVerticies
+
+	Copies the last skinned verticies into the VBO.
+	Must be called on the render thread.
+=============
+*/
+void MD5Mesh::UploadSkinnedVerticies( void ) {
+	if ( !skinnedDataPending ) {
+		return;
+	}
+
+	//Respecifying the whole store lets the driver orphan the buffer the GPU may still be reading
+    glBindBuffer( GL_ARRAY_BUFFER, dynamicVboName );
+    glBufferData( GL_ARRAY_BUFFER, sizeof( float ) * DYNAMIC_VERTEX_FLOATS * vertexCount, skinnedVertexData, GL_STREAM_DRAW );
     glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	skinnedDataPending = false;
 }
 /*
 =============
 MD5Mesh::SetVertexBufferToBindPose
 
-	Resets the vertex buffer to the bind pose.
-	This is needed for GPU skinning.
+	Called when switching to GPU skinning.
+	The GPU paths read the bind stream which CPU skinning never
+	touches, so only a pending CPU skin has to be dropped.
 =============
 */
 void MD5Mesh::SetVertexBufferToBindPose( void ) {
+	skinnedDataPending = false;
+}
+/*
+=============
+MD5Mesh::GetMemoryUsage
+
+	Returns the memory held by the mesh, not counting its texture.
+	The GPU estimate is the size of the vertex streams and index buffer.
+=============
+*/
+MemoryUsage MD5Mesh::GetMemoryUsage( void ) const {
+	unsigned boneIndiciesSize = 4 * ( ( boneIndexType == GL_UNSIGNED_BYTE ) ? sizeof( GLubyte ) : sizeof( GLushort ) );
+	return MemoryUsage( sizeof( MD5Mesh ) + GetCPUMemory(),
+						vertexCount * ( DYNAMIC_VERTEX_FLOATS * sizeof( float ) + sizeof( PackedBindVertex ) + sizeof( PackedStaticVertex ) + boneIndiciesSize ) + indexCount * sizeof( GLuint ) );
+}
+/*
+=============
+MD5Mesh::GetTextureMemoryUsage
+
+	Returns the memory held by the diffuse texture.
+	The GPU estimate is the uncompressed image without mips.
+=============
+*/
+MemoryUsage MD5Mesh::GetTextureMemoryUsage( void ) const {
+	if ( diffuseTexture == NULL ) {
+		return MemoryUsage();
+	}
+	return MemoryUsage( sizeof( Texture ), diffuseTexture->width * diffuseTexture->height * ( diffuseTexture->bitsPerPixel / 8 ) );
+}
+/*
+=============
+MD5Mesh::MarkUsedJoints
+
+	Flags every joint referenced by one of the mesh's weights.
+=============
+*/
+void MD5Mesh::MarkUsedJoints( std::vector<bool>& usedJoints ) const {
+	for ( MeshJointInfluences::const_iterator influence = jointInfluences.begin();
+		  influence != jointInfluences.end(); ++influence ) {
+		if ( influence->joint < usedJoints.size() ) {
+			usedJoints[influence->joint] = true;
+		}
+	}
+}
+/*
+=============
+MD5Mesh::AccumulateJointInfluence
+
+	Adds up the bias every joint contributes across the mesh.
+=============
+*/
+void MD5Mesh::AccumulateJointInfluence( std::vector<float>& influence ) const {
+	for ( MeshJointInfluences::const_iterator jointInfluence = jointInfluences.begin();
+		  jointInfluence != jointInfluences.end(); ++jointInfluence ) {
+		if ( jointInfluence->joint < influence.size() ) {
+			influence[jointInfluence->joint] += jointInfluence->bias;
+		}
+	}
+}
+/*
+=============
+MD5Mesh::GetBindPoseRadius
+
+	Returns the distance of the furthest bind pose vertex from the origin.
+=============
+*/
+float MD5Mesh::GetBindPoseRadius( void ) const {
+	return bindPoseRadius;
+}
+/*
+=============
+MD5Mesh::RemapBoneIndicies
 
-    glBindBuffer( GL_ARRAY_BUFFER, vboName );
+	Rewrites the GPU bone indicies through a joint remap table.
+	Used so the GPU palette only holds the joints the model needs.
+	boneJoints keeps the original joint indicies so this works
+	after the CPU data is released.
+=============
+*/
+void MD5Mesh::RemapBoneIndicies( const std::vector<int>& jointRemap ) {
+	UploadBoneIndicies( &jointRemap );
+}
+/*
+=============
+MD5Mesh::UploadBoneIndicies
 
-	float newValues[6];
-	unsigned vertexIndex = 0;
-	for ( Verticies::iterator vertex = verticies.begin();
-		  vertex != verticies.end(); ++vertex, ++vertexIndex ) {
- 
-		memcpy( &newValues[0], &vertex->bindPosition[0], sizeof( float ) * 3 ); //Vertex Position
-		memcpy( &newValues[3], &vertex->bindNormal[0]  , sizeof( float ) * 3 ); //Vertex Normal
+	Uploads the bone indicies of every vertex from boneJoints,
+	through jointRemap if it's set. A remapped index is never
+	bigger than its joint, so boneIndexType still fits.
+=============
+*/
+void MD5Mesh::UploadBoneIndicies( const std::vector<int>* jointRemap ) {
+	if ( boneJoints.empty() ) {
+		return;
+	}
 
-		glBufferSubData( GL_ARRAY_BUFFER, sizeof( float ) * 16 * vertexIndex, sizeof( float ) * 6, &newValues[0] );
+	std::vector<GLushort> indicies( boneJoints.size() );
+	for ( unsigned i = 0; i < boneJoints.size(); ++i ) {
+		unsigned joint = boneJoints[i];
+		if ( jointRemap != NULL ) {
+			int remappedJoint	= ( joint < jointRemap->size() ) ? ( *jointRemap )[joint] : -1;
+			joint				= ( unsigned )std::max( remappedJoint, 0 ); //Unused slots have no weight
+		}
+		indicies[i] = ( GLushort )joint;
 	}
 
+    glBindBuffer( GL_ARRAY_BUFFER, boneIndexVboName );
+	if ( boneIndexType == GL_UNSIGNED_BYTE ) {
+		std::vector<GLubyte> byteIndicies( indicies.begin(), indicies.end() );
+		glBufferData( GL_ARRAY_BUFFER, sizeof( GLubyte ) * byteIndicies.size(), &byteIndicies[0], GL_STATIC_DRAW );
+	} else {
+		glBufferData( GL_ARRAY_BUFFER, sizeof( GLushort ) * indicies.size(), &indicies[0], GL_STATIC_DRAW );
+	}
     glBindBuffer( GL_ARRAY_BUFFER, 0 );
 }
 /*
@@ -199,18 +654,21 @@ MD5Mesh::ReadVertex
 	Reads a vertex from a char buffer.
 =============
 */
-void MD5Mesh::ReadVertex( char* startPosition ) {
+void MD5Mesh::ReadVertex( char* startPosition, VertexBindData* bindData ) {
 
 	char* nextToken = NULL;
 
-	int vertexIndex = std::atoi( strtok_s( startPosition, " ", &nextToken ) );						 //Read the vertex index
+	unsigned vertexIndex = std::atoi( strtok_s( startPosition, " ", &nextToken ) );					 //Read the vertex index
+	if ( vertexIndex >= weightRanges.size() ) {
+		printf( "Vertex %u is out of range\n", vertexIndex );
+		return;
+	}
 
-	Vertex& currentVertex = verticies[vertexIndex];
-	currentVertex.vertexIndex = vertexIndex;
+	VertexWeightRange& weightRange = weightRanges[vertexIndex];
 
-	FileOperations::ReadVec2( strtok_s( NULL, "()", &nextToken ), currentVertex.textureCoordinate ); //Read texture coordinates
-	currentVertex.startWeight = std::atoi( strtok_s( NULL, " ", &nextToken ) );						 //Read start weight
-	currentVertex.countWeight = std::atoi( strtok_s( NULL, " ", &nextToken ) );						 //Read weight count
+	FileOperations::ReadVec2( strtok_s( NULL, "()", &nextToken ), bindData[vertexIndex].textureCoordinate ); //Read texture coordinates
+	weightRange.startWeight = std::atoi( strtok_s( NULL, " ", &nextToken ) );								 //Read start weight
+	weightRange.countWeight = std::atoi( strtok_s( NULL, " ", &nextToken ) );								 //Read weight count
 }
 /*
 =============
@@ -222,14 +680,18 @@ MD5Mesh::ReadWeight
 void MD5Mesh::ReadWeight( char* startPosition ) {
 	char* nextToken = NULL;
 
-	int weightIndex = std::atoi( strtok_s( startPosition, " ", &nextToken ) );					//Read the weight index
+	unsigned weightIndex = std::atoi( strtok_s( startPosition, " ", &nextToken ) );				//Read the weight index
+	if ( weightIndex >= weightJoints.size() ) {
+		printf( "Weight %u is out of range\n", weightIndex );
+		return;
+	}
 
-	Weight& currentWeight = weights[weightIndex];
-	currentWeight.weightIndex = weightIndex;
+	glm::vec3 position;
+	weightJoints[weightIndex]	= std::atoi( strtok_s( NULL, " ", &nextToken ) );				//Read joint
+	float bias					= ( float )std::atof( strtok_s( NULL, " ", &nextToken ) );		//Read bias
+	FileOperations::ReadVec3( strtok_s( NULL, "()", &nextToken ), position );					//Read position
 
-	currentWeight.joint = std::atoi( strtok_s( NULL, " ", &nextToken ) );						//Read joint
-	currentWeight.bias  = ( float )std::atof( strtok_s( NULL, " ", &nextToken ) );				//Read bias
-	FileOperations::ReadVec3( strtok_s( NULL, "()", &nextToken ), currentWeight.position );		//Read position
+	weightPositions[weightIndex] = glm::vec4( position, bias );
 }
 /*
 =============
@@ -238,14 +700,17 @@ MD5Mesh::ReadTriangle
 	Reads an index from a char buffer.
 =============
 */
-void MD5Mesh::ReadTriangle( char* startPosition ) {
+void MD5Mesh::ReadTriangle( char* startPosition, Triangle* triangles ) {
 
 	char* nextToken = NULL;
 
-	int triIndex = std::atoi( strtok_s( startPosition, " ", &nextToken ) );	
+	unsigned triIndex = std::atoi( strtok_s( startPosition, " ", &nextToken ) );	
+	if ( triIndex >= triangleCount ) {
+		printf( "Triangle %u is out of range\n", triIndex );
+		return;
+	}
 
 	Triangle& currentTri = triangles[triIndex];
-	currentTri.triIndex = triIndex;
 	
 	currentTri.indices[0] = std::atoi( strtok_s( NULL, " ", &nextToken ) );
 	currentTri.indices[1] = std::atoi( strtok_s( NULL, " ", &nextToken ) );
@@ -256,53 +721,158 @@ void MD5Mesh::ReadTriangle( char* startPosition ) {
 MD5Mesh::BuildBindPose
 
 	Computes bind pose of the mesh.
-	Generates the vertex buffer for the mesh.
+	Generates the vertex streams for the mesh.
+	The streams, index buffer and bind data only live in loadArena until they're uploaded.
+=============
+*/
+void MD5Mesh::BuildBindPose( const Joints& joints, const Triangle* triangles, VertexBindData* bindData, ArenaAllocator& loadArena ) {
+	vertexCount = weightRanges.size();
+	skinnedVertexData					= new float[vertexCount * DYNAMIC_VERTEX_FLOATS]; //ReleaseCPUData blows this away for models that only skin on the GPU
+	PackedBindVertex*	bindStream		= loadArena.AllocateArray<PackedBindVertex>( vertexCount );
+	PackedStaticVertex*	staticStream	= loadArena.AllocateArray<PackedStaticVertex>( vertexCount );
+	GLuint*				indicies		= static_cast<GLuint*>( loadArena.Allocate( sizeof( GLuint ) * triangleCount * 3 ) ); //3 indicies per tri
+
+	ComputeVerticies( joints, bindData, staticStream, loadArena );
+	ComputeIndicies( triangles, indicies );
+	ComputeNormals( joints, triangles, bindData );    
+	BuildRuntimeSummary( bindData );
+	BuildPaletteStreams( bindData, staticStream );
+
+	for ( unsigned vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex ) {
+		bindStream[vertexIndex].position	= bindData[vertexIndex].bindPosition;
+		bindStream[vertexIndex].normal		= glm::packSnorm3x10_1x2( glm::vec4( bindData[vertexIndex].bindNormal, 0.0f ) );
+
+		//The CPU stream starts in the bind pose until the first skin
+		memcpy( &skinnedVertexData[vertexIndex * DYNAMIC_VERTEX_FLOATS]    , &bindData[vertexIndex].bindPosition[0], sizeof( float ) * 3 ); //Vertex Position
+		memcpy( &skinnedVertexData[vertexIndex * DYNAMIC_VERTEX_FLOATS + 3], &bindData[vertexIndex].bindNormal[0]  , sizeof( float ) * 3 ); //Vertex Normal
+	}
+
+	Upload( indicies, bindStream, staticStream ); //Upload to OpenGL
+}
+/*
+=============
+MD5Mesh::BuildRuntimeSummary
+
+	Keeps what the model still needs after the CPU data is released.
+	The total bias of every joint and the bind radius, ComputeVerticies
+	fills in the original bone joints.
+=============
+*/
+void MD5Mesh::BuildRuntimeSummary( const VertexBindData* bindData ) {
+	std::vector<float>	jointBias;
+	std::vector<bool>	jointReferenced;
+	for ( unsigned weight = 0; weight < weightJoints.size(); ++weight ) {
+		unsigned joint = weightJoints[weight];
+		if ( joint >= jointBias.size() ) {
+			jointBias.resize( joint + 1, 0.0f );
+			jointReferenced.resize( joint + 1, false );
+		}
+		jointBias[joint]		+= weightPositions[weight].w;
+		jointReferenced[joint]	= true;
+	}
+
+	jointInfluences.clear();
+	for ( unsigned joint = 0; joint < jointBias.size(); ++joint ) {
+		if ( jointReferenced[joint] ) {
+			MeshJointInfluence influence;
+			influence.joint	= joint;
+			influence.bias	= jointBias[joint];
+			jointInfluences.push_back( influence );
+		}
+	}
+
+	bindPoseRadius = 0.0f;
+	for ( unsigned vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex ) {
+		bindPoseRadius = std::max( bindPoseRadius, glm::length( bindData[vertexIndex].bindPosition ) );
+	}
+}
+/*
+=============
+MD5Mesh::BuildPaletteStreams
+
+	Keeps the bind pose and the top 4 bone weights for
+	4 bone palette skinning on the CPU.
+	The weights are the quantized ones the GPU reads.
+	Released with the rest of the CPU data.
 =============
 */
-void MD5Mesh::BuildBindPose( const Joints& joints ) {
-	//TODO: These buffers can probably be blown these away since any future updates are done on the GPU
-	vertexData = new float[verticies.size() * 16];   // 3 for position + 3 for normal + 2 for texture + 4 for boneIds + 4 for matrixId
-	indexBuffer = new GLuint[triangles.size() * 3]; //3 indicies per tri
+void MD5Mesh::BuildPaletteStreams( const VertexBindData* bindData, const PackedStaticVertex* staticStream ) {
+	bindPositions.resize( vertexCount );
+	bindNormals.resize( vertexCount );
+	boneWeights.resize( vertexCount );
 
-	ComputeVerticies( joints );
-	ComputeIndicies();
-	ComputeNormals( joints );    
+	for ( unsigned vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex ) {
+		const GLubyte* quantizedWeights = staticStream[vertexIndex].boneWeights;
 
-	Upload(); //Upload to OpenGL
+		bindPositions[vertexIndex]	= glm::vec4( bindData[vertexIndex].bindPosition, 1.0f );
+		bindNormals[vertexIndex]	= glm::vec4( bindData[vertexIndex].bindNormal, 0.0f );
+		boneWeights[vertexIndex]	= glm::vec4( quantizedWeights[0], quantizedWeights[1], quantizedWeights[2], quantizedWeights[3] ) * ( 1.0f / 255.0f );
+	}
+}
+/*
+=============
+QuantizeBoneWeights
+
+	Stores 4 bone weights as unorm8. The largest weight takes
+	the rounding error so they still sum to exactly 255.
+=============
+*/
+static void QuantizeBoneWeights( const glm::vec4& weights, GLubyte* quantized ) {
+	int total	= 0;
+	int largest	= 0;
+	for ( int i = 0; i < 4; ++i ) {
+		quantized[i]	= ( GLubyte )glm::clamp( weights[i] * 255.0f + 0.5f, 0.0f, 255.0f );
+		total			+= quantized[i];
+		if ( weights[i] > weights[largest] ) {
+			largest = i;
+		}
+	}
+
+	if ( total > 0 ) {
+		quantized[largest] = ( GLubyte )( quantized[largest] + 255 - total );
+	}
 }
 /*
 =============
 MD5Mesh::ComputeVerticies
 
 	Computes the verticies for the bind pose.
+	Fills the packed static stream and the original bone joints.
 =============
 */
-void MD5Mesh::ComputeVerticies( const Joints& joints ) {
-	int vertexIndex = 0;
-	std::vector<Weight> weightsToSort;
-	weightsToSort.reserve( 10 );
+void MD5Mesh::ComputeVerticies( const Joints& joints, VertexBindData* bindData, PackedStaticVertex* staticStream, ArenaAllocator& loadArena ) {
+	unsigned maxWeights = 0;
+	for ( VertexWeightRanges::const_iterator weightRange = weightRanges.begin();
+		  weightRange != weightRanges.end(); ++weightRange ) {
+		maxWeights = std::max( maxWeights, weightRange->countWeight );
+	}
+	Weight*	 weightsToSort	= loadArena.AllocateArray<Weight>( maxWeights );
+	unsigned sortCount		= 0;
+
+	boneJoints.assign( vertexCount * 4, 0 );
 
-	for ( Verticies::iterator currentVertex = verticies.begin();
-		  currentVertex != verticies.end(); ++currentVertex, ++vertexIndex ) {
+	for ( unsigned vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex ) {
 		glm::vec3 vertexPosition    = glm::vec3( 0.0f );
+		glm::vec4 boneWeights		= glm::vec4( 0.0f );
 
-		unsigned weightStart = currentVertex->startWeight;
-		unsigned weightCount = currentVertex->countWeight;
+		unsigned weightStart = weightRanges[vertexIndex].startWeight;
+		unsigned weightCount = weightRanges[vertexIndex].countWeight;
 		
 		//Calculate position using all weights
 		for ( unsigned i = 0; i < weightCount; i++ ) {            
-			Weight&			currentWeight	= weights[weightStart + i];
+			Weight&			currentWeight	= weightsToSort[sortCount++];
+			currentWeight.joint		= weightJoints[weightStart + i];
+			currentWeight.position	= glm::vec3( weightPositions[weightStart + i] );
+			currentWeight.bias		= weightPositions[weightStart + i].w;
 			const Joint&	currentJoint	= joints[currentWeight.joint];            
-			
-			weightsToSort.push_back( currentWeight );
 
 			glm::vec3 weightedVertex = currentJoint.orientation * currentWeight.position;
 			vertexPosition += ( ( currentJoint.position + weightedVertex ) * currentWeight.bias );
 		}
 
 		float scaleAmount = 1.0f;
-		if ( weightsToSort.size() > 4 ) {
-			std::sort( weightsToSort.begin(), weightsToSort.end() );
+		if ( sortCount > 4 ) {
+			std::sort( weightsToSort, weightsToSort + sortCount );
 			float currentBiasTotal = 0.0f;
 			for ( int i = 0; i < 4; ++i ) {
 				currentBiasTotal += weightsToSort[i].bias;
@@ -310,19 +880,18 @@ void MD5Mesh::ComputeVerticies( const Joints& joints ) {
 			scaleAmount = 1.0f / currentBiasTotal; //How much the weights should scale to = 1.
 		}	
 		//Figure out which verticies are most important since they're out of order by default
-		for ( unsigned i = 0; i < weightsToSort.size() && i < 4; ++i ) {
-			currentVertex->boneWeights[i]	= weightsToSort[i].bias * scaleAmount;
-			currentVertex->boneIndicies[i]	= ( float )weightsToSort[i].joint;
+		for ( unsigned i = 0; i < sortCount && i < 4; ++i ) {
+			boneWeights[i]						= weightsToSort[i].bias * scaleAmount;
+			boneJoints[vertexIndex * 4 + i]		= ( unsigned short )weightsToSort[i].joint;
 		}
 
-		memcpy( &vertexData[vertexIndex * 16]     , &vertexPosition[0]					, sizeof( float ) * 3 ); //Vertex Position
-		memcpy( &vertexData[vertexIndex * 16 + 6] , &currentVertex->textureCoordinate[0], sizeof( float ) * 2 ); //Vertex TexCoord
-        memcpy( &vertexData[vertexIndex * 16 + 8] , &currentVertex->boneWeights[0]		, sizeof( float ) * 4 ); //Vertex Weights
-        memcpy( &vertexData[vertexIndex * 16 + 12], &currentVertex->boneIndicies[0]		, sizeof( float ) * 4 ); //Matrix Indicies
+		PackedStaticVertex& staticVertex = staticStream[vertexIndex];
+		staticVertex.textureCoordinate = glm::packHalf2x16( bindData[vertexIndex].textureCoordinate ); //Vertex TexCoord
+		QuantizeBoneWeights( boneWeights, staticVertex.boneWeights ); //Vertex Weights
 
-		currentVertex->bindPosition = vertexPosition;
+		bindData[vertexIndex].bindPosition = vertexPosition;
 		
-		weightsToSort.clear();
+		sortCount = 0;
 	}
 }
 /*
@@ -332,15 +901,11 @@ MD5Mesh::ComputeIndicies
 	Computes the indicies for mesh.
 =============
 */
-void MD5Mesh::ComputeIndicies( void ) {
-	int triangleIndex = 0;
-	for ( Triangles::iterator currentTri = triangles.begin();
-		  currentTri != triangles.end(); ++currentTri ) {
-		memcpy( &indexBuffer[triangleIndex * 3], &currentTri->indices[0], sizeof( GLuint ) * 3 );
-		++triangleIndex;
+void MD5Mesh::ComputeIndicies( const Triangle* triangles, GLuint* indicies ) {
+	for ( unsigned triangleIndex = 0; triangleIndex < triangleCount; ++triangleIndex ) {
+		memcpy( &indicies[triangleIndex * 3], &triangles[triangleIndex].indices[0], sizeof( GLuint ) * 3 );
 	}
-	indexCount = triangles.size() * 3;
-    triangleCount = triangles.size();
+	indexCount = triangleCount * 3;
 }
 /*
 =============
@@ -349,37 +914,34 @@ MD5Mesh::ComputeNormals
 	Computes the normals for the bind pose.
 =============
 */
-void MD5Mesh::ComputeNormals( const Joints& joints ) {
+void MD5Mesh::ComputeNormals( const Joints& joints, const Triangle* triangles, VertexBindData* bindData ) {
 	//Calculate the average normals for each vertex
-	for ( Triangles::iterator currentTriangle = triangles.begin();
-		  currentTriangle != triangles.end(); ++currentTriangle ) {
-		glm::vec3 faceNormal = glm::cross( verticies[currentTriangle->indices[2]].bindPosition - verticies[currentTriangle->indices[0]].bindPosition,
-										   verticies[currentTriangle->indices[1]].bindPosition - verticies[currentTriangle->indices[0]].bindPosition );
+	for ( const Triangle* currentTriangle = triangles;
+		  currentTriangle != triangles + triangleCount; ++currentTriangle ) {
+		glm::vec3 faceNormal = glm::cross( bindData[currentTriangle->indices[2]].bindPosition - bindData[currentTriangle->indices[0]].bindPosition,
+										   bindData[currentTriangle->indices[1]].bindPosition - bindData[currentTriangle->indices[0]].bindPosition );
 		
-		verticies[currentTriangle->indices[0]].bindNormal += faceNormal;
-		verticies[currentTriangle->indices[1]].bindNormal += faceNormal;
-		verticies[currentTriangle->indices[2]].bindNormal += faceNormal;
+		bindData[currentTriangle->indices[0]].bindNormal += faceNormal;
+		bindData[currentTriangle->indices[1]].bindNormal += faceNormal;
+		bindData[currentTriangle->indices[2]].bindNormal += faceNormal;
 	}
 
-	int vertexIndex = 0;
-	for ( Verticies::iterator currentVertex = verticies.begin();
-		  currentVertex != verticies.end(); ++currentVertex ) {
-		currentVertex->bindNormal = glm::normalize( currentVertex->bindNormal );
-		memcpy( &vertexData[vertexIndex * 16 + 3], &currentVertex->bindNormal[0], sizeof( float ) * 3 );
+	for ( unsigned vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex ) {
+		glm::vec3& bindNormal = bindData[vertexIndex].bindNormal;
+		bindNormal = glm::normalize( bindNormal );
 
-		int weightCount = currentVertex->countWeight;
-		int weightStart = currentVertex->startWeight;
+		unsigned weightCount = weightRanges[vertexIndex].countWeight;
+		unsigned weightStart = weightRanges[vertexIndex].startWeight;
 
 		//Calculate normal to joint local space
 		//This is apparently faster for calculating the normal later
-		for ( int i = 0; i < weightCount; i++ ) {            
-			Weight& currentWeight		= weights[weightStart + i];
-			const Joint&  currentJoint  = joints[currentWeight.joint];
+		glm::vec3 jointNormal = glm::vec3( 0.0f );
+		for ( unsigned i = 0; i < weightCount; i++ ) {            
+			const Joint& currentJoint = joints[weightJoints[weightStart + i]];
 
-		   currentVertex->jointNormal += ( ( currentVertex->bindNormal * currentJoint.orientation ) * currentWeight.bias );
+			jointNormal += ( ( bindNormal * currentJoint.orientation ) * weightPositions[weightStart + i].w );
 		}
-
-		vertexIndex++;
+		jointNormals[vertexIndex] = jointNormal;
 	}
 }
 /*
@@ -399,7 +961,7 @@ void MD5Mesh::Render( ModelSkinningType skinningType ) {
 	
     if ( skinningType == CPU_SKINNING ) {
         RenderCPUSkinning();
-    } else if ( skinningType == GPU_SKINNING ) {
+    } else if ( skinningType == GPU_SKINNING || skinningType == GPU_BAKED_SKINNING || skinningType == GPU_DUAL_QUATERNION_SKINNING ) {
         RenderGPUSkinning();
     }
 
@@ -434,17 +996,38 @@ void MD5Mesh::RenderGPUSkinning( void ) {
 MD5Mesh::Upload
 
 	Uploads the mesh to OpenGL Server.
+	The CPU VAO reads the dynamic stream, the GPU VAO the packed bind
+	stream and bone indicies, both share the static stream and the
+	index buffer. Only the CPU skinned stream is still full floats.
 	Returns whether or not it was successful
 =============
 */
-bool MD5Mesh::Upload( void ) {
+bool MD5Mesh::Upload( const GLuint* indicies, const PackedBindVertex* bindStream, const PackedStaticVertex* staticStream ) {
     if ( !SetupOpenGLBuffers() ) {
         return false;
     }
 
+	const GLsizei dynamicStride	= sizeof( float ) * DYNAMIC_VERTEX_FLOATS;
+	const GLsizei bindStride	= sizeof( PackedBindVertex );
+	const GLsizei staticStride	= sizeof( PackedStaticVertex );
+
+	unsigned highestJoint = 0;
+	for ( unsigned i = 0; i < boneJoints.size(); ++i ) {
+		highestJoint = std::max<unsigned>( highestJoint, boneJoints[i] );
+	}
+	boneIndexType = ( highestJoint > 255 ) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+
+    glBindBuffer( GL_ARRAY_BUFFER, dynamicVboName );
+    glBufferData( GL_ARRAY_BUFFER, dynamicStride * vertexCount, skinnedVertexData, GL_STREAM_DRAW ); //Bind pose until the first CPU skin
+    glBindBuffer( GL_ARRAY_BUFFER, bindVboName );
+    glBufferData( GL_ARRAY_BUFFER, bindStride * vertexCount, bindStream, GL_STATIC_DRAW );
+    glBindBuffer( GL_ARRAY_BUFFER, staticVboName );
+    glBufferData( GL_ARRAY_BUFFER, staticStride * vertexCount, staticStream, GL_STATIC_DRAW );
+	UploadBoneIndicies( NULL );
+
     glBindVertexArray( cpuVaoName );
-    glBindBuffer( GL_ARRAY_BUFFER, vboName );
     glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, iboName );
+    glBufferData( GL_ELEMENT_ARRAY_BUFFER, sizeof( GLuint ) * indexCount, indicies, GL_STATIC_DRAW );
 
     glEnableVertexAttribArray( 0 );
     glEnableVertexAttribArray( 1 );
@@ -452,17 +1035,15 @@ bool MD5Mesh::Upload( void ) {
     glDisableVertexAttribArray( 3 ); //Don't need these for CPU Skinning
     glDisableVertexAttribArray( 4 ); //Don't need these for CPU Skinning
 
-    glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, sizeof( float ) * 16, ( void* )( 0 ) );
-    glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, sizeof( float ) * 16, ( void* )( 3 * sizeof( float ) ) );
-    glVertexAttribPointer( 2, 2, GL_FLOAT, GL_FALSE, sizeof( float ) * 16, ( void* )( 6 * sizeof( float ) ) );
-
-    glBufferData( GL_ARRAY_BUFFER, ( sizeof( float ) * 16 ) * verticies.size(), vertexData, GL_DYNAMIC_DRAW );
-    glBufferData( GL_ELEMENT_ARRAY_BUFFER, sizeof( GLuint ) * indexCount, indexBuffer, GL_STATIC_DRAW );
+    glBindBuffer( GL_ARRAY_BUFFER, dynamicVboName );
+    glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, dynamicStride, ( void* )( 0 ) );
+    glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, dynamicStride, ( void* )( 3 * sizeof( float ) ) );
+    glBindBuffer( GL_ARRAY_BUFFER, staticVboName );
+    glVertexAttribPointer( 2, 2, GL_HALF_FLOAT, GL_FALSE, staticStride, ( void* )( offsetof( PackedStaticVertex, textureCoordinate ) ) );
 
     glBindVertexArray( 0 );
 
     glBindVertexArray( gpuVaoName );
-    glBindBuffer( GL_ARRAY_BUFFER, vboName );
     glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, iboName );
 
     glEnableVertexAttribArray( 0 );
@@ -471,13 +1052,17 @@ bool MD5Mesh::Upload( void ) {
     glEnableVertexAttribArray( 3 );
     glEnableVertexAttribArray( 4 );
 
-    glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, sizeof( float ) * 16, ( void* )( 0 ) );
-    glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, sizeof( float ) * 16, ( void* )( 3 * sizeof( float ) ) );
-    glVertexAttribPointer( 2, 2, GL_FLOAT, GL_FALSE, sizeof( float ) * 16, ( void* )( 6 * sizeof( float ) ) );
-    glVertexAttribPointer( 3, 4, GL_FLOAT, GL_FALSE, sizeof( float ) * 16, ( void* )( 8 * sizeof( float ) ) );
-    glVertexAttribPointer( 4, 4, GL_FLOAT, GL_FALSE, sizeof( float ) * 16, ( void* )( 12 * sizeof( float ) ) );
+    glBindBuffer( GL_ARRAY_BUFFER, bindVboName );
+    glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, bindStride, ( void* )( offsetof( PackedBindVertex, position ) ) );
+    glVertexAttribPointer( 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, bindStride, ( void* )( offsetof( PackedBindVertex, normal ) ) );
+    glBindBuffer( GL_ARRAY_BUFFER, staticVboName );
+    glVertexAttribPointer( 2, 2, GL_HALF_FLOAT, GL_FALSE, staticStride, ( void* )( offsetof( PackedStaticVertex, textureCoordinate ) ) );
+    glVertexAttribPointer( 3, 4, GL_UNSIGNED_BYTE, GL_TRUE, staticStride, ( void* )( offsetof( PackedStaticVertex, boneWeights ) ) );
+    glBindBuffer( GL_ARRAY_BUFFER, boneIndexVboName );
+    glVertexAttribIPointer( 4, 4, boneIndexType, 0, ( void* )( 0 ) ); //Integer attribute, read as a uvec4
 
     glBindVertexArray( 0 );
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
 
 	unsigned shaderNameLength = shaderName.size();
 	if ( shaderNameLength > 3 && 
@@ -492,6 +1077,7 @@ bool MD5Mesh::Upload( void ) {
 MD5Mesh::SetupOpenGLBuffers
 
 	Sets up the required buffers on the GPU.
+	Anything generated before a failure is freed by the destructor.
 =============
 */
 bool MD5Mesh::SetupOpenGLBuffers( void ) {
@@ -504,24 +1090,21 @@ bool MD5Mesh::SetupOpenGLBuffers( void ) {
     glGenVertexArrays( 1, &gpuVaoName );
     if ( gpuVaoName == 0 ) {
         printf( "Error generating GPU VAO\n" );
-        glDeleteVertexArrays( 1, &cpuVaoName );
         return false;
     }
 
-    glGenBuffers( 1, &vboName );
-    if ( vboName == 0 ) {
-        printf( "Error generating VBO\n" );
-        glDeleteVertexArrays( 1, &cpuVaoName );
-        glDeleteVertexArrays( 1, &gpuVaoName );
+    glGenBuffers( 1, &dynamicVboName );
+    glGenBuffers( 1, &staticVboName );
+    glGenBuffers( 1, &bindVboName );
+    glGenBuffers( 1, &boneIndexVboName );
+    if ( dynamicVboName == 0 || staticVboName == 0 || bindVboName == 0 || boneIndexVboName == 0 ) {
+        printf( "Error generating VBOs\n" );
         return false;
     }
 	
     glGenBuffers( 1, &iboName );
     if ( iboName == 0 ) {
         printf( "Error generating IBO\n" );
-        glDeleteVertexArrays( 1, &cpuVaoName );
-        glDeleteVertexArrays( 1, &gpuVaoName );
-        glDeleteBuffers( 1, &vboName );
         return false;
     }
 
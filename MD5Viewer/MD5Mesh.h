@@ -7,6 +7,11 @@
 #include <GL\glew.h>
 #include "MD5ModelStructs.h"
 #include "MD5AnimationStructs.h"
+#include "ArenaAllocator.h"
+#include "MemoryReport.h"
+#include "SkinningKernel.h"
+
+#define DYNAMIC_VERTEX_FLOATS	6	//Position and normal, rewritten by CPU skinning
 
 /*
 ========================
@@ -21,48 +26,97 @@ class MD5Mesh {
 public:
 					~MD5Mesh( void );
 
-	static MD5Mesh*	CreateMeshFromData( char* data, const Joints& jointData, char** endPosition );
-	bool			InitWithData( char* data, const Joints& jointData, char** endPosition );
+	static MD5Mesh*	CreateMeshFromData( char* data, const Joints& jointData, char** endPosition, ArenaAllocator& loadArena );
+	bool			InitWithData( char* data, const Joints& jointData, char** endPosition, ArenaAllocator& loadArena );
 	
-	void			ApplySkeleton( const Skeleton& skeleton );
+	void			SkinVerticies( const Skeleton& skeleton );
+	void			SkinVerticiesPalette( const glm::mat4* palette );
+	void			SkinVerticiesDualQuaternion( const DualQuaternion* palette );
+	void			SkinVertexRange( const Skeleton& skeleton, unsigned firstVertex, unsigned count );
+	void			SkinVertexRangePalette( const glm::mat4* palette, unsigned firstVertex, unsigned count );
+	void			SkinVertexRangeDualQuaternion( const DualQuaternion* palette, unsigned firstVertex, unsigned count );
+	void			FinishSkinning( void );
+	inline unsigned	GetVertexCount( void ) const { return vertexCount; }
+	unsigned		MeasurePaletteError( const Skeleton& skeleton, const glm::mat4* palette, float& maxError, float& totalError ) const;
+	void			UploadSkinnedVerticies( void );
 	void			SetVertexBufferToBindPose( void );
 
+	void			MarkUsedJoints( std::vector<bool>& usedJoints ) const;
+	void			AccumulateJointInfluence( std::vector<float>& influence ) const;
+	float			GetBindPoseRadius( void ) const;
+	void			RemapBoneIndicies( const std::vector<int>& jointRemap );
+
 	void			Render( ModelSkinningType skinningType );
 
+	void			ReleaseCPUData( void );
+	bool			RestoreCPUData( char* data, const Joints& jointData, char** endPosition, ArenaAllocator& loadArena );
+	inline bool		HasCPUData( void ) const { return skinnedVertexData != NULL; }
+	unsigned		GetCPUMemory( void ) const;
+	MemoryUsage		GetMemoryUsage( void ) const;
+	MemoryUsage		GetTextureMemoryUsage( void ) const;
+	inline const std::string& GetShaderName( void ) const { return shaderName; }
+
 private:
 public:
 	std::string     shaderName;
     
 	GLuint          indexCount;
 	GLuint          triangleCount;
-	GLuint          vboName;
+	GLuint			vertexCount;
+	GLuint			dynamicVboName;			//CPU skinned position and normal
+	GLuint			staticVboName;			//Attributes that never change, PackedStaticVertex
+	GLuint			bindVboName;			//Bind pose position and normal for GPU skinning, PackedBindVertex
+	GLuint			boneIndexVboName;		//4 bone indicies per vertex, integer attributes
+	GLenum			boneIndexType;			//GL_UNSIGNED_BYTE unless a joint index doesn't fit
 	GLuint          iboName;
 	GLuint          cpuVaoName;
     GLuint          gpuVaoName;
 	
-	float*          vertexData;
-	GLuint*         indexBuffer;
+	float*			skinnedVertexData;		//Skinned position and normal per vertex, waiting for upload
+	bool			skinnedDataPending;
+
+	//CPU skinning data, one entry per vertex
+	VertexWeightRanges			weightRanges;
+	VertexWeightBuckets			weightBuckets;		//Verticies are sorted by weight count
+	std::vector<glm::vec3>		jointNormals;		//Bind normal in the space of each weight's joint, pre-weighted
+
+	//CPU skinning data, one entry per weight, split so the kernel streams through them
+	std::vector<glm::vec4>		weightPositions;	//Position in xyz, bias in w
+	std::vector<unsigned>		weightJoints;
+
+	//4 bone palette skinning data, one entry per vertex, the bone joints are in boneJoints
+	std::vector<glm::vec4>		bindPositions;
+	std::vector<glm::vec4>		bindNormals;
+	std::vector<glm::vec4>		boneWeights;
 
-	Verticies       verticies;
-	Triangles       triangles;
-	Weights         weights;
+	//Kept when the CPU data is released
+	MeshJointInfluences			jointInfluences;
+	std::vector<unsigned short>	boneJoints;			//Original joint of each of the 4 bone slots per vertex
+	float						bindPoseRadius;
 
 	Texture*        diffuseTexture;
 
 					MD5Mesh( void );
 
-	bool			Upload( void );
+	bool			Upload( const GLuint* indicies, const PackedBindVertex* bindStream, const PackedStaticVertex* staticStream );
+	void			UploadBoneIndicies( const std::vector<int>* jointRemap );
     bool            SetupOpenGLBuffers( void );
 
-	void			BuildBindPose( const Joints& joints );
+	bool			ParseMeshData( char* data, char** endPosition, ArenaAllocator& loadArena, Triangle** triangles, VertexBindData** bindData );
+	void			SortVerticiesByWeightCount( Triangle* triangles, VertexBindData* bindData, ArenaAllocator& loadArena );
+	void			BuildBindPose( const Joints& joints, const Triangle* triangles, VertexBindData* bindData, ArenaAllocator& loadArena );
+	void			BuildRuntimeSummary( const VertexBindData* bindData );
+	void			BuildPaletteStreams( const VertexBindData* bindData, const PackedStaticVertex* staticStream );
+	SkinningStreams	GetSkinningStreams( void ) const;
+	PaletteSkinningStreams GetPaletteStreams( void ) const;
 
-	void			ComputeVerticies( const Joints& joints );
-	void			ComputeNormals( const Joints& joints );
-	void			ComputeIndicies( void );
+	void			ComputeVerticies( const Joints& joints, VertexBindData* bindData, PackedStaticVertex* staticStream, ArenaAllocator& loadArena );
+	void			ComputeNormals( const Joints& joints, const Triangle* triangles, VertexBindData* bindData );
+	void			ComputeIndicies( const Triangle* triangles, GLuint* indicies );
 
-	void			ReadVertex( char* startingPosition );
+	void			ReadVertex( char* startingPosition, VertexBindData* bindData );
 	void			ReadWeight( char* startingPostion );
-	void			ReadTriangle( char* startingPosition );
+	void			ReadTriangle( char* startingPosition, Triangle* triangles );
 
     void            RenderCPUSkinning( void );
     void            RenderGPUSkinning( void );
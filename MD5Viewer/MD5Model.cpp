@@ -1,6 +1,41 @@
 #include "MD5Model.h"
 #include "MD5FileOperations.h"
+#include "Timer.h"
 #include <fstream>
+#include <algorithm>
+
+//Verticies skinned per job, their weights and output stay well inside a core's L2
+#define CPU_SKINNING_CHUNK_VERTICIES	512
+
+/*
+=============
+SameBlendInputs
+
+	Returns true if two sets of blend layers give the same pose.
+=============
+*/
+static bool SameBlendInputs( const AnimationBlendInputs& a, const AnimationBlendInputs& b ) {
+	if ( a.size() != b.size() ) {
+		return false;
+	}
+
+	for ( unsigned i = 0; i < a.size(); ++i ) {
+		if ( a[i].clip != b[i].clip || a[i].mask != b[i].mask || a[i].time != b[i].time ||
+			 a[i].weight != b[i].weight || a[i].additive != b[i].additive ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+const AnimationLODSettings MD5Model::AnimationLODTable[ANIMATION_LOD_COUNT] = {
+	//minScreenSize	updateInterval	minJointInfluence
+	{ 0.25f,		0.0f,			0.0f  },	//ANIMATION_LOD_FULL
+	{ 0.1f,			1.0f / 30.0f,	0.01f },	//ANIMATION_LOD_REDUCED
+	{ 0.02f,		1.0f / 15.0f,	0.05f },	//ANIMATION_LOD_MINIMAL
+	{ 0.0f,			0.0f,			1.0f  }		//ANIMATION_LOD_FROZEN
+};
 /*
 =============
 MD5Model::MD5Model
@@ -9,16 +44,38 @@ MD5Model::MD5Model
 =============
 */
 MD5Model::MD5Model( void ) :
+    modelName( "NULL" ),
+	animationLOD( ANIMATION_LOD_FULL ),
+	lodTimer( 0.0f ),
+	lodPosesValid( false ),
+	boundingRadius( 0.0f ),
+	poseHistoryEnabled( false ),
+	poseHistoryInterval( 0.0f ),
+	poseHistoryCount( 0 ),
+	poseCache( NULL ),
+	sharedPoseEntry( NULL ),
+	sharedPoseFrame( 0 ),
+	paletteBakingEnabled( false ),
+	bakedPaletteValid( false ),
+	animationBufferName( 0 ),
+	animationTextureName( 0 ),
+	animationTextureSize( 0 ),
 	animate( false ),
 	animation1Index( 0 ),
 	animation2Index( -1 ),
 	blendAmount( 0.0f ),
     matrixBufferName( 0 ),
     matrixTextureName( 0 ),
+	poseVersion( 1 ),
+	skinnedPoseVersion( 0 ),
+	uploadedPoseVersion( 0 ),
+	posedLOD( ANIMATION_LOD_COUNT ),
 	animation1( NULL ),
 	animation2( NULL ),
-    modelName( "NULL" ),
-    skinningType( CPU_SKINNING )
+    skinningType( CPU_SKINNING ),
+	gpuResident( false ),
+	cpuSkinningMode( CPU_SKINNING_ALL_WEIGHTS ),
+	skinningJobSystem( NULL )
 {}
 /*
 =============
@@ -28,6 +85,8 @@ MD5Model::~MD5Model
 =============
 */
 MD5Model::~MD5Model( void ) {
+	ReleaseAnimationTexture();
+
 	for ( MD5Animations::iterator currentAnim = animations.begin();
 		  currentAnim != animations.end(); ++currentAnim ) {
 		delete *currentAnim;
@@ -68,6 +127,46 @@ MD5Model* MD5Model::CreateMD5ModelWithMesh( const char* path ) {
 }
 /*
 =============
+MD5Model::CreateMD5ModelInstance
+
+	Loads another copy of a model with its animations,
+	requested joints, transform, material and skinning
+	settings. The copy starts with the same animations
+	playing, from the start.
+=============
+*/
+MD5Model* MD5Model::CreateMD5ModelInstance( const MD5Model* source ) {
+	MD5Model* model = CreateMD5ModelWithMesh( source->sourcePath.c_str() );
+	if ( model == NULL ) {
+		return NULL;
+	}
+
+	for ( MD5Animations::const_iterator anim = source->animations.begin();
+		  anim != source->animations.end(); ++anim ) {
+		model->AddAnimation( ( *anim )->GetSourcePath().c_str() );
+	}
+	for ( unsigned i = 0; i < source->requestedJoints.size(); ++i ) {
+		if ( source->requestedJoints[i] ) {
+			model->RequestJoint( source->joints[i].name.c_str() );
+		}
+	}
+
+	model->modelMatrix		= source->modelMatrix;
+	model->materialColor	= source->materialColor;
+	model->SetCPUSkinningMode( source->cpuSkinningMode );
+	model->SetPaletteBakingEnabled( source->paletteBakingEnabled );
+	model->SetSkinningType( source->skinningType );
+	model->SetGPUResident( source->gpuResident );
+
+	if ( source->animation1Index > -1 && source->animation2Index > -1 ) {
+		model->PlayBlendedAnimation( source->animation1Index, source->animation2Index, source->blendAmount );
+	} else {
+		model->PlaySingleAnimation( source->animation1Index );
+	}
+	return model;
+}
+/*
+=============
 MD5Model::InitMD5ModelWithMesh
 
 	Initializes MD5Model with the mesh at the path.
@@ -80,7 +179,8 @@ bool MD5Model::InitMD5ModelWithMesh( const char* path ) {
 		return false;
 	}
 
-	char* fileData = FileOperations::ReadFileToCharBuffer( path );
+	ArenaAllocator	loadArena; //Load temporaries, freed in one go when the load returns
+	char*			fileData = FileOperations::ReadFileToArena( path, loadArena );
 
 	if ( fileData == NULL ) { //File wasn't opened
 		printf( "Mesh at path '%s' could not be opened\n", path );
@@ -88,6 +188,7 @@ bool MD5Model::InitMD5ModelWithMesh( const char* path ) {
 	} else {
 		printf( "Beginning load of: %s\n", path );
 
+		sourcePath		= path;
         modelName       = path;
         unsigned slash  = modelName.find_last_of( "/" ) + 1;
         unsigned dot    = modelName.find_last_of( "." );
@@ -104,41 +205,49 @@ bool MD5Model::InitMD5ModelWithMesh( const char* path ) {
 				nextParam[2] = '\0'; //Truncate to 2 chars
 				 if ( !STRINGS_ARE_EQUAL( nextParam, "10" ) ) {
 					printf( "Only MD5Version 10 is supported\n" );
-					delete[] fileData;
 					return false;                
 				 }
 			} else if ( STRINGS_ARE_EQUAL( currentParam, "numJoints" ) ) { //Read numjoints
 				int numJoints = std::atoi( nextParam );
 				joints.resize( numJoints );
-				blendSkeleton.joints.resize( numJoints );
-                blendSkeleton.jointMatricies.resize( numJoints );                
+				pose.joints.resize( numJoints );
+                pose.jointMatricies.resize( numJoints );                
 			} else if ( STRINGS_ARE_EQUAL( currentParam, "numMeshes" ) ) { //Read nummeshes
 				int numMeshes = std::atoi( nextParam );
 				meshes.reserve( numMeshes );
 			} else if ( STRINGS_ARE_EQUAL( currentParam, "joints" ) ) { //Read joints
 				if ( joints.size() == 0 ) {
 					printf( "numJoints was not specified\n" );
-					delete[] fileData;
 					return false;    
 				}
 				nextLineToken = ReadJoints( nextLineToken );
 			} else if ( STRINGS_ARE_EQUAL( currentParam, "mesh" ) ) { //Read a mesh
-				nextLineToken = ReadMesh( nextLineToken );
+				nextLineToken = ReadMesh( nextLineToken, loadArena );
+				if ( nextLineToken == NULL ) {
+					printf( "Mesh in '%s' could not be read\n", path );
+					return false;
+				}
 			}
 
 			currentLine = strtok_s( NULL, "\n", &nextLineToken );
 		}
 
 		GenerateBindPoseMatricies();
+		UpdateActiveJoints();
+
+		for ( MD5Meshes::iterator currentMesh = meshes.begin();
+			  currentMesh != meshes.end(); ++currentMesh ) {
+			boundingRadius = std::max( boundingRadius, ( *currentMesh )->GetBindPoseRadius() );
+		}
 
 		printf( "   MD5Mesh file parsed\n" );
 		printf( "      Joint count:\t%i\n", joints.size() );
+		printf( "      Active joints:\t%i\n", activeJoints.size() );
 		printf( "      Mesh count:\t%i\n", meshes.size() );        
 		printf( "Successfully Loaded MD5Mesh: %s\n", path );        
 
 	}
     
-    delete[] fileData;
 
 	return SetupMatrixTextureBuffer();
 }
@@ -146,7 +255,8 @@ bool MD5Model::InitMD5ModelWithMesh( const char* path ) {
 =============
 MD5Model::SetupMatrixTextureBuffer
 
-	Sets up the texture buffer for GPU skinning
+	Sets up the texture buffer for GPU skinning.
+	Each active joint has a packed 3x4 matrix, 3 texels.
 =============
 */
 bool MD5Model::SetupMatrixTextureBuffer( void ) {
@@ -164,13 +274,13 @@ bool MD5Model::SetupMatrixTextureBuffer( void ) {
     }
 
     glm::mat4 matrix(1.0); //Init to bind pose
-    float* matrixBuffer = new float[joints.size() * 4 * 4];
-    for ( unsigned i = 0; i < joints.size() * 4 * 4; i += 16 ) {
-        memcpy( &matrixBuffer[i], &matrix[0], sizeof( float ) * 16 );
+    float* matrixBuffer = new float[activeJoints.size() * PALETTE_MATRIX_FLOATS];
+    for ( unsigned i = 0; i < activeJoints.size() * PALETTE_MATRIX_FLOATS; i += PALETTE_MATRIX_FLOATS ) {
+        PackPaletteMatrix( matrix, &matrixBuffer[i] );
     }
 
     glBindBuffer( GL_TEXTURE_BUFFER, matrixBufferName );
-    glBufferData( GL_TEXTURE_BUFFER, sizeof( float ) * joints.size() * 4 * 4, matrixBuffer, GL_DYNAMIC_DRAW );
+    glBufferData( GL_TEXTURE_BUFFER, sizeof( float ) * activeJoints.size() * PALETTE_MATRIX_FLOATS, matrixBuffer, GL_DYNAMIC_DRAW );
     glBindBuffer( GL_TEXTURE_BUFFER, 0 );
 
     delete[] matrixBuffer;
@@ -197,15 +307,19 @@ MD5Model::AddAnimation
 =============
 */
 bool MD5Model::AddAnimation( const char* path ) {
-	MD5Animation* newAnimation = MD5Animation::CreateAnimationFromFile( path );
+	MD5Animation* newAnimation = MD5Animation::CreateAnimationFromFile( path, &activeJoints );
 	
 	if ( newAnimation != NULL ) {
 		animations.push_back( newAnimation );  
+		if ( paletteBakingEnabled ) {
+			newAnimation->BakePalettes( activeJoints, inverseBoneMatricies );
+		}
+		if ( animationTextureName != 0 ) {
+			BuildAnimationTexture();
+		}
 		if ( animations.size() == 1 ) { //First anim added
 			animate = true;
-			animation1Index = 0;
-			animation1 = animations[0];
-			animation2Index = -1;
+			PlaySingleAnimation( 0 );
 		}
 		return true;
 	}
@@ -259,12 +373,17 @@ MD5Model::ReadMesh
 
 	Reads all meshes from a char buffer.
 	Stores them in meshes.
-	Returns a pointer to where the buffer should continue reading.
+	Returns a pointer to where the buffer should continue reading,
+	or NULL if the mesh couldn't be read.
 =============
 */
-char* MD5Model::ReadMesh( char* startingPosition ) {	
-	char* endPosition;
-	meshes.push_back( MD5Mesh::CreateMeshFromData( startingPosition, joints, &endPosition ) );	
+char* MD5Model::ReadMesh( char* startingPosition, ArenaAllocator& loadArena ) {	
+	char* endPosition = NULL;
+	MD5Mesh* mesh = MD5Mesh::CreateMeshFromData( startingPosition, joints, &endPosition, loadArena );
+	if ( mesh == NULL ) {
+		return NULL;
+	}
+	meshes.push_back( mesh );	
 	return endPosition;
 }
 /*
@@ -272,6 +391,7 @@ char* MD5Model::ReadMesh( char* startingPosition ) {
 MD5Model::GenerateBindPoseMatricies
 
 	Creates the inverse matrix for all joints.
+	Starts the pose in the bind pose.
 =============
 */
 void MD5Model::GenerateBindPoseMatricies( void ) {
@@ -285,10 +405,204 @@ void MD5Model::GenerateBindPoseMatricies( void ) {
         glm::mat4 finalMatrix   = translation * rotation;
 
         inverseBoneMatricies[matrixIndex] = glm::inverse( finalMatrix );    
+
+		pose.joints[matrixIndex].parentID		= joint->parentID;
+		pose.joints[matrixIndex].position		= joint->position;
+		pose.joints[matrixIndex].orientation	= joint->orientation;
+		pose.jointMatricies[matrixIndex]		= finalMatrix;
     }
 }
 /*
 =============
+MD5Model::UpdateActiveJoints
+
+	Works out which joints need evaluating.
+	A joint is needed if a weight references it, it was requested
+	or it is the parent of a needed joint.
+	Builds the remap table into the compact GPU palette.
+=============
+*/
+void MD5Model::UpdateActiveJoints( void ) {
+	std::vector<bool> usedJoints( joints.size(), false );
+
+	for ( MD5Meshes::iterator currentMesh = meshes.begin();
+		  currentMesh != meshes.end(); ++currentMesh ) {
+		( *currentMesh )->MarkUsedJoints( usedJoints );
+	}
+	for ( unsigned i = 0; i < requestedJoints.size() && i < usedJoints.size(); ++i ) {
+		usedJoints[i] = usedJoints[i] || requestedJoints[i];
+	}
+
+	//Children come after parents so walking backwards pulls in every ancestor
+	for ( int i = ( int )joints.size() - 1; i >= 0; --i ) {
+		int parentID = joints[i].parentID;
+		if ( usedJoints[i] && parentID > -1 ) {
+			usedJoints[parentID] = true;
+		}
+	}
+
+	activeJoints.clear();
+	jointRemap.assign( joints.size(), -1 );
+	for ( unsigned i = 0; i < joints.size(); ++i ) {
+		if ( usedJoints[i] ) {
+			jointRemap[i] = activeJoints.size();
+			activeJoints.push_back( i );
+		}
+	}
+
+	for ( MD5Meshes::iterator currentMesh = meshes.begin();
+		  currentMesh != meshes.end(); ++currentMesh ) {
+		( *currentMesh )->RemapBoneIndicies( jointRemap );
+	}
+
+	BuildLODJointSets();
+}
+/*
+=============
+MD5Model::BuildLODJointSets
+
+	Works out which active joints are evaluated at each LOD.
+	Joints with little influence on the mesh are skipped and
+	follow their closest evaluated ancestor using the bind pose.
+=============
+*/
+void MD5Model::BuildLODJointSets( void ) {
+	std::vector<float> influence( joints.size(), 0.0f );
+	for ( MD5Meshes::iterator currentMesh = meshes.begin();
+		  currentMesh != meshes.end(); ++currentMesh ) {
+		( *currentMesh )->AccumulateJointInfluence( influence );
+	}
+	float maxInfluence = ( influence.empty() ) ? 0.0f : *std::max_element( influence.begin(), influence.end() );
+
+	for ( unsigned level = 0; level < ANIMATION_LOD_COUNT; ++level ) {
+		float				minInfluence = AnimationLODTable[level].minJointInfluence * maxInfluence;
+		std::vector<bool>	evaluated( joints.size(), false );
+
+		for ( JointIndicies::iterator joint = activeJoints.begin(); joint != activeJoints.end(); ++joint ) {
+			evaluated[*joint] = ( influence[*joint] >= minInfluence );
+		}
+		//Children come after parents so walking backwards pulls in every ancestor
+		for ( int i = ( int )joints.size() - 1; i >= 0; --i ) {
+			if ( evaluated[i] && joints[i].parentID > -1 ) {
+				evaluated[joints[i].parentID] = true;
+			}
+		}
+
+		lodJoints[level].clear();
+		lodFollowers[level].clear();
+		lodFollowOffsets[level].clear();
+
+		for ( JointIndicies::iterator joint = activeJoints.begin(); joint != activeJoints.end(); ++joint ) {
+			int ancestor = joints[*joint].parentID;
+			while ( ancestor > -1 && !evaluated[ancestor] ) {
+				ancestor = joints[ancestor].parentID;
+			}
+
+			if ( evaluated[*joint] || ancestor < 0 ) {
+				evaluated[*joint] = true;
+				lodJoints[level].push_back( *joint );
+				continue;
+			}
+
+			const Joint&		ancestorJoint		= joints[ancestor];
+			glm::quat			inverseOrientation	= glm::conjugate( ancestorJoint.orientation );
+			SkeletonJoint		offset;
+
+			offset.parentID		= ancestor;
+			offset.position		= inverseOrientation * ( joints[*joint].position - ancestorJoint.position );
+			offset.orientation	= inverseOrientation * joints[*joint].orientation;
+
+			lodFollowers[level].push_back( *joint );
+			lodFollowOffsets[level].push_back( offset );
+		}
+	}
+
+	lodPosesValid = false;
+}
+/*
+=============
+MD5Model::SetAnimationLOD
+
+	Sets how much work goes into animating the model.
+=============
+*/
+void MD5Model::SetAnimationLOD( AnimationLODLevel level ) {
+	if ( level != animationLOD && level < ANIMATION_LOD_COUNT ) {
+		animationLOD	= level;
+		lodPosesValid	= false;
+		lodTimer		= 0.0f;
+	}
+}
+/*
+=============
+MD5Model::SelectAnimationLOD
+
+	Picks the LOD for a projected size.
+	screenSize is the projected bounding radius as a
+	fraction of half the screen height.
+=============
+*/
+void MD5Model::SelectAnimationLOD( float screenSize ) {
+	unsigned level = ANIMATION_LOD_FULL;
+	while ( level < ANIMATION_LOD_FROZEN && screenSize < AnimationLODTable[level].minScreenSize ) {
+		++level;
+	}
+	SetAnimationLOD( ( AnimationLODLevel )level );
+}
+/*
+=============
+MD5Model::ComputeScreenSize
+
+	Returns the projected bounding radius as a fraction of half the screen height.
+=============
+*/
+float MD5Model::ComputeScreenSize( const glm::vec3& cameraPosition, float tanHalfFieldOfView ) const {
+	glm::vec3	modelPosition	= glm::vec3( modelMatrix[3] );
+	float		distance		= std::max( glm::length( cameraPosition - modelPosition ), 1.0f );
+	return boundingRadius / ( distance * tanHalfFieldOfView );
+}
+/*
+=============
+MD5Model::RequestJoint
+
+	Keeps a joint evaluated even if no vertex depends on it.
+	Use this for attachment joints.
+	Returns false if there is no joint with that name.
+=============
+*/
+bool MD5Model::RequestJoint( const char* jointName ) {
+	unsigned jointIndex = 0;
+	while ( jointIndex < joints.size() && joints[jointIndex].name.compare( jointName ) != 0 ) {
+		++jointIndex;
+	}
+	if ( jointIndex == joints.size() ) {
+		return false;
+	}
+	if ( jointRemap[jointIndex] > -1 ) {
+		return true; //Already evaluated
+	}
+
+	requestedJoints.resize( joints.size(), false );
+	requestedJoints[jointIndex] = true;
+	UpdateActiveJoints();
+
+	for ( MD5Animations::iterator currentAnim = animations.begin();
+		  currentAnim != animations.end(); ++currentAnim ) {
+		( *currentAnim )->BuildSkeletonFrames( &activeJoints );
+	}
+	SetPaletteBakingEnabled( paletteBakingEnabled );
+	if ( animationTextureName != 0 ) {
+		BuildAnimationTexture();
+	}
+
+	glDeleteTextures( 1, &matrixTextureName );
+	glDeleteBuffers( 1, &matrixBufferName );
+	bool created		= SetupMatrixTextureBuffer();
+	uploadedPoseVersion	= 0; //The new buffer only holds identity matricies
+	return created;
+}
+/*
+=============
 MD5Model::PlayAnimation
 
 	Plays the animation at the index.
@@ -303,13 +617,18 @@ void MD5Model::PlaySingleAnimation( int index ) {
 			animation1 = NULL;			
 		} else {
 			animation1 = animations[index];
-			animation1->SetCurrentFrame( 0 );
 		}
 	}
 
 	animation2		= NULL;
 	animation2Index = -1;
 	blendAmount		= 0.0f;
+
+	blendLayers.clear();
+	if ( animation1 ) {
+		blendLayers.push_back( AnimationBlendInput( animation1, 0.0f, 1.0f ) );
+	}
+	poseHistoryCount = 0;
 }
 /*
 =============
@@ -328,43 +647,403 @@ void MD5Model::PlayBlendedAnimation( int index1, int index2, float blend ) {
 		animation2		= animations[animation2Index];
 		blendAmount		= blend;
 
-		animation1->SetCurrentFrame( 0 );
-		animation2->SetCurrentFrame( 0 );
+		blendLayers.clear();
+		blendLayers.push_back( AnimationBlendInput( animation1, 0.0f, 1.0f - blendAmount ) );
+		blendLayers.push_back( AnimationBlendInput( animation2, 0.0f, blendAmount ) );
+		poseHistoryCount = 0;
+	}
+}
+/*
+=============
+MD5Model::PlayLayeredAnimation
+
+	Plays any number of weighted and additive clips.
+	The first two layers are reported as the playing animations.
+=============
+*/
+void MD5Model::PlayLayeredAnimation( const AnimationBlendInputs& layers ) {
+	blendLayers		= layers;
+	animation1		= NULL;
+	animation2		= NULL;
+	animation1Index = -1;
+	animation2Index = -1;
+	blendAmount		= 0.0f;
+
+	poseHistoryCount = 0;
+
+	for ( unsigned i = 0; i < blendLayers.size() && i < 2; ++i ) {
+		MD5Animations::iterator found = std::find( animations.begin(), animations.end(), blendLayers[i].clip );
+		if ( found == animations.end() ) {
+			continue;
+		}
+
+		if ( i == 0 ) {
+			animation1		= *found;
+			animation1Index = found - animations.begin();
+		} else {
+			animation2		= *found;
+			animation2Index = found - animations.begin();
+			blendAmount		= blendLayers[i].weight;
+		}
+	}
+}
+/*
+=============
+MD5Model::BuildBoneMask
+
+	Builds a bone mask from a joint and optionally its children.
+	Masks can be set on layers passed to PlayLayeredAnimation.
+	Returns false if there is no joint with that name.
+=============
+*/
+bool MD5Model::BuildBoneMask( const char* jointName, bool includeChildren, BoneMask& mask ) const {
+	if ( !BuildBoneMaskFromJoints( joints, jointName, includeChildren, mask ) ) {
+		return false;
+	}
+
+	BoneMask::iterator newEnd = mask.begin();
+	for ( BoneMask::iterator joint = mask.begin(); joint != mask.end(); ++joint ) {
+		if ( jointRemap[*joint] > -1 ) { //Pruned joints are never evaluated
+			*newEnd++ = *joint;
+		}
 	}
+	mask.erase( newEnd, mask.end() );
+
+	return true;
 }
 /*
 =============
 MD5Model::Update
 
-	Update the animation
+	Update the animation.
+	Makes no OpenGL calls, CPU skinned verticies are
+	uploaded when the model is rendered.
+	The pose is only evaluated and skinned when its inputs
+	changed, poseVersion tells the rest of the chain.
 =============
 */
 void MD5Model::Update( float dt ) {
-	if ( animate && animation1 ) {
-
-        animation1->Update( dt );
-		
-        if ( animation2 && animation1 != animation2 ) { //If animation1 & animation2 are the same don't update twice.
-			animation2->Update( dt );
-			MD5Animation::InterpolateSkeletonFrames( animation1->GetCurrentSkeleton(), animation2->GetCurrentSkeleton(), blendSkeleton, blendAmount );
-		}
-
-		if ( skinningType == CPU_SKINNING ) { 
-			const Skeleton* currentSkeleton = &animation1->GetCurrentSkeleton();
-			if ( animation2 ) {
-				if ( animation1 != animation2 && blendAmount != 0.0f ) {
-					if ( blendAmount > 0.99f ) {
-						currentSkeleton = &animation2->GetCurrentSkeleton();
-					} else {
-						currentSkeleton = &blendSkeleton;
-					}
-				}
+	if ( !animate || blendLayers.empty() ) {
+		return;
+	}
+
+	for ( AnimationBlendInputs::iterator layer = blendLayers.begin();
+		  layer != blendLayers.end(); ++layer ) {
+		if ( layer->clip ) {
+			layer->time = layer->clip->WrapTime( layer->time + dt * layer->clip->GetPlaybackRate() );
+		}
+	}
+
+	//The vertex shader samples the clip, only the time is needed
+	if ( skinningType == GPU_BAKED_SKINNING || animationLOD == ANIMATION_LOD_FROZEN ) {
+		return;
+	}
+
+	//Same clips, times and weights give the same pose, unless LOD interpolation is moving it
+	if ( posedLOD == animationLOD && AnimationLODTable[animationLOD].updateInterval <= 0.0f && SameBlendInputs( blendLayers, posedLayers ) ) {
+		if ( skinningType == CPU_SKINNING && skinnedPoseVersion != poseVersion ) {
+			SkinMeshesOnCPU();
+		}
+		return;
+	}
+	posedLayers = blendLayers;
+	posedLOD	= animationLOD;
+
+	//A single baked clip only needs its two keyframe palettes interpolated
+	const MD5Animation* bakedClip = GetBakedPaletteClip();
+	if ( bakedClip != NULL ) {
+		bakedPalette.resize( activeJoints.size() * PALETTE_MATRIX_FLOATS );
+		bakedPaletteValid	= bakedClip->SampleBakedPalette( blendLayers[0].time, &bakedPalette[0] );
+		sharedPoseEntry		= NULL;
+		if ( bakedPaletteValid ) {
+			MarkPoseChanged();
+			return;
+		}
+	}
+	bakedPaletteValid = false;
+
+	float updateInterval = AnimationLODTable[animationLOD].updateInterval;
+	if ( updateInterval <= 0.0f ) {
+		EvaluatePose( pose );
+	} else {
+		//Sample at a lower rate and interpolate between the last two samples
+		lodTimer += dt;
+		if ( !lodPosesValid ) {
+			lodNextPose = pose;
+			EvaluatePose( lodNextPose );
+			lodPreviousPose = lodNextPose;
+			lodTimer		= 0.0f;
+			lodPosesValid	= true;
+		} else if ( lodTimer >= updateInterval ) {
+			lodPreviousPose.joints.swap( lodNextPose.joints );
+			lodPreviousPose.jointMatricies.swap( lodNextPose.jointMatricies );
+			EvaluatePose( lodNextPose );
+			lodTimer = std::min( lodTimer - updateInterval, updateInterval );
+		}
+		MD5Animation::InterpolateSkeletonFrames( lodPreviousPose, lodNextPose, pose, lodTimer / updateInterval, &activeJoints );
+		sharedPoseEntry = NULL;
+	}
+	MarkPoseChanged();
+
+	if ( poseHistoryEnabled ) {
+		previousEvaluatedPose.joints.swap( lastEvaluatedPose.joints );
+		previousEvaluatedPose.jointMatricies.swap( lastEvaluatedPose.jointMatricies );
+		lastEvaluatedPose	= pose;
+		poseHistoryInterval = dt;
+		poseHistoryCount	= std::min( poseHistoryCount + 1, 2U );
+	}
+
+	if ( skinningType == CPU_SKINNING && skinnedPoseVersion != poseVersion ) { 
+		SkinMeshesOnCPU();
+    } 
+}
+/*
+=============
+MD5Model::SetPoseHistoryEnabled
+
+	Keeps the last two evaluated poses so the pose can be
+	extrapolated on frames the model isn't updated.
+=============
+*/
+void MD5Model::SetPoseHistoryEnabled( bool enabled ) {
+	poseHistoryEnabled	= enabled;
+	poseHistoryCount	= 0;
+	if ( !enabled ) {
+		lastEvaluatedPose		= Skeleton();
+		previousEvaluatedPose	= Skeleton();
+	}
+}
+/*
+=============
+MD5Model::ExtrapolatePose
+
+	Moves the pose along the motion between the last two evaluated poses.
+	Used instead of Update when there is no time to evaluate the model.
+	Extrapolates at most one update interval ahead.
+	Returns false if there isn't enough history.
+=============
+*/
+bool MD5Model::ExtrapolatePose( float timeSinceUpdate ) {
+	if ( !poseHistoryEnabled || poseHistoryCount < 2 || poseHistoryInterval <= 0.0f ||
+		 animationLOD == ANIMATION_LOD_FROZEN || bakedPaletteValid || skinningType == GPU_BAKED_SKINNING ) {
+		return false;
+	}
+
+	float amount = std::min( timeSinceUpdate / poseHistoryInterval, 1.0f );
+	sharedPoseEntry = NULL;
+
+	for ( JointIndicies::iterator joint = activeJoints.begin(); joint != activeJoints.end(); ++joint ) {
+		const SkeletonJoint&	previousJoint	= previousEvaluatedPose.joints[*joint];
+		const SkeletonJoint&	lastJoint		= lastEvaluatedPose.joints[*joint];
+		SkeletonJoint&			goalJoint		= pose.joints[*joint];
+		glm::mat4&				matrix			= pose.jointMatricies[*joint];
+
+		glm::quat deltaOrientation = lastJoint.orientation * glm::conjugate( previousJoint.orientation );
+
+		goalJoint.position		= lastJoint.position + ( ( lastJoint.position - previousJoint.position ) * amount );
+		goalJoint.orientation	= glm::normalize( glm::slerp( glm::quat(), deltaOrientation, amount ) * lastJoint.orientation );
+
+		matrix			= glm::toMat4( goalJoint.orientation );
+		matrix[3][0]	= goalJoint.position.x;
+		matrix[3][1]	= goalJoint.position.y;
+		matrix[3][2]	= goalJoint.position.z;
+	}
+	MarkPoseChanged();
+	InvalidatePose(); //The next Update evaluates rather than keeping the extrapolated pose
+
+	if ( skinningType == CPU_SKINNING ) { 
+		SkinMeshesOnCPU();
+    } 
+
+	return true;
+}
+/*
+=============
+MD5Model::MarkPoseChanged
+
+	Called whenever pose or bakedPalette is written so skinning
+	and uploads know their copies are out of date.
+=============
+*/
+void MD5Model::MarkPoseChanged( void ) {
+	++poseVersion;
+}
+/*
+=============
+MD5Model::SkinMeshesOnCPU
+
+	Skins every mesh from the current pose with the CPU skinning mode.
+	With a skinning job system the verticies of all the meshes are
+	split into chunks that are skinned in parallel, straight into
+	each mesh's skinned vertex data. Uploading is left to Render.
+=============
+*/
+void MD5Model::SkinMeshesOnCPU( void ) {
+	skinnedPoseVersion = poseVersion;
+
+	if ( cpuSkinningMode == CPU_SKINNING_PALETTE ) {
+		BuildCPUPalette();
+	} else if ( cpuSkinningMode == CPU_SKINNING_DUAL_QUATERNION ) {
+		BuildCPUDualQuaternions();
+	}
+
+	if ( skinningJobSystem == NULL ) {
+		for ( MD5Meshes::iterator currentMesh = meshes.begin();
+			  currentMesh != meshes.end(); ++currentMesh ) {
+			if ( cpuSkinningMode == CPU_SKINNING_PALETTE ) {
+				( *currentMesh )->SkinVerticiesPalette( &cpuPalette[0] );
+			} else if ( cpuSkinningMode == CPU_SKINNING_DUAL_QUATERNION ) {
+				( *currentMesh )->SkinVerticiesDualQuaternion( &cpuDualQuaternions[0] );
+			} else {
+				( *currentMesh )->SkinVerticies( pose );
 			}
-            for ( MD5Meshes::iterator currentMesh = meshes.begin();
-				    currentMesh != meshes.end(); ++currentMesh ) {
-			    ( *currentMesh )->ApplySkeleton( *currentSkeleton );
-		    }
-        } 
+		}
+		return;
+	}
+
+	if ( skinningChunks.empty() ) {
+		BuildSkinningChunks();
+	}
+
+	skinningJobSystem->ParallelFor( skinningChunks.size(), 1, [this]( unsigned begin, unsigned end ) {
+		for ( unsigned i = begin; i < end; ++i ) {
+			const SkinningChunk& chunk = skinningChunks[i];
+			if ( cpuSkinningMode == CPU_SKINNING_PALETTE ) {
+				chunk.mesh->SkinVertexRangePalette( &cpuPalette[0], chunk.firstVertex, chunk.vertexCount );
+			} else if ( cpuSkinningMode == CPU_SKINNING_DUAL_QUATERNION ) {
+				chunk.mesh->SkinVertexRangeDualQuaternion( &cpuDualQuaternions[0], chunk.firstVertex, chunk.vertexCount );
+			} else {
+				chunk.mesh->SkinVertexRange( pose, chunk.firstVertex, chunk.vertexCount );
+			}
+		}
+	} );
+
+	for ( MD5Meshes::iterator currentMesh = meshes.begin();
+		  currentMesh != meshes.end(); ++currentMesh ) {
+		( *currentMesh )->FinishSkinning();
+	}
+}
+/*
+=============
+MD5Model::BuildSkinningChunks
+
+	Splits every mesh's verticies into the ranges skinned by each job.
+=============
+*/
+void MD5Model::BuildSkinningChunks( void ) {
+	skinningChunks.clear();
+	for ( MD5Meshes::iterator currentMesh = meshes.begin();
+		  currentMesh != meshes.end(); ++currentMesh ) {
+		unsigned vertexCount = ( *currentMesh )->GetVertexCount();
+		for ( unsigned firstVertex = 0; firstVertex < vertexCount; firstVertex += CPU_SKINNING_CHUNK_VERTICIES ) {
+			SkinningChunk chunk;
+			chunk.mesh			= *currentMesh;
+			chunk.firstVertex	= firstVertex;
+			chunk.vertexCount	= std::min( vertexCount - firstVertex, ( unsigned )CPU_SKINNING_CHUNK_VERTICIES );
+			skinningChunks.push_back( chunk );
+		}
+	}
+}
+/*
+=============
+MD5Model::BuildCPUPalette
+
+	Builds the skinning palette for the current pose, the same
+	matricies the GPU gets but indexed by joint.
+	Only active joints are updated, no weight references the rest.
+=============
+*/
+void MD5Model::BuildCPUPalette( void ) {
+	if ( cpuPalette.size() != joints.size() ) {
+		cpuPalette.assign( joints.size(), glm::mat4( 1.0f ) );
+	}
+
+	for ( JointIndicies::const_iterator joint = activeJoints.begin();
+		  joint != activeJoints.end(); ++joint ) {
+		cpuPalette[*joint] = pose.jointMatricies[*joint] * inverseBoneMatricies[*joint];
+	}
+}
+/*
+=============
+MD5Model::BuildCPUDualQuaternions
+
+	Builds the dual quaternion palette for the current pose,
+	the same transforms the GPU gets but indexed by joint.
+	They come straight from the joint orientations and
+	positions, no matricies are involved.
+=============
+*/
+void MD5Model::BuildCPUDualQuaternions( void ) {
+	if ( cpuDualQuaternions.size() != joints.size() ) {
+		cpuDualQuaternions.assign( joints.size(), DualQuaternion() );
+	}
+
+	for ( JointIndicies::const_iterator joint = activeJoints.begin();
+		  joint != activeJoints.end(); ++joint ) {
+		const SkeletonJoint& poseJoint = pose.joints[*joint];
+		cpuDualQuaternions[*joint] = MakeSkinningDualQuaternion( poseJoint.orientation, poseJoint.position, joints[*joint].orientation, joints[*joint].position );
+	}
+}
+/*
+=============
+MD5Model::EvaluatePose
+
+	Blends the playing layers into destination at the current LOD.
+	With a pose cache, instances in the same playback state
+	copy one shared evaluation instead.
+=============
+*/
+void MD5Model::EvaluatePose( Skeleton& destination ) {
+	sharedPoseEntry = NULL;
+
+	if ( poseCache == NULL ) {
+		MD5Animation::EvaluateBlend( blendLayers, destination, &lodJoints[animationLOD] );
+		ApplyLODFollowers( destination );
+		return;
+	}
+
+	poseCache->BuildKey( sourcePath, activeJoints, animationLOD, blendLayers, poseCacheKey, poseCacheInputs );
+
+	PoseCacheEntry* entry = poseCache->FindOrEvaluate( poseCacheKey, [this, &destination]( Skeleton& cachedPose ) {
+		cachedPose = destination;
+		MD5Animation::EvaluateBlend( poseCacheInputs, cachedPose, &lodJoints[animationLOD] );
+		ApplyLODFollowers( cachedPose );
+	} );
+
+	for ( JointIndicies::iterator joint = activeJoints.begin(); joint != activeJoints.end(); ++joint ) {
+		destination.joints[*joint]			= entry->pose.joints[*joint];
+		destination.jointMatricies[*joint]	= entry->pose.jointMatricies[*joint];
+	}
+
+	sharedPoseEntry = entry;
+	sharedPoseFrame = poseCache->GetFrame();
+}
+/*
+=============
+MD5Model::ApplyLODFollowers
+
+	Moves the joints skipped at the current LOD rigidly
+	with their closest evaluated ancestor.
+=============
+*/
+void MD5Model::ApplyLODFollowers( Skeleton& destination ) const {
+	const JointIndicies&	followers	= lodFollowers[animationLOD];
+	const SkeletonJoints&	offsets		= lodFollowOffsets[animationLOD];
+
+	for ( unsigned i = 0; i < followers.size(); ++i ) {
+		const SkeletonJoint&	offset		= offsets[i];
+		const SkeletonJoint&	ancestor	= destination.joints[offset.parentID];
+		SkeletonJoint&			follower	= destination.joints[followers[i]];
+		glm::mat4&				matrix		= destination.jointMatricies[followers[i]];
+
+		follower.parentID		= joints[followers[i]].parentID;
+		follower.position		= ancestor.position + ( ancestor.orientation * offset.position );
+		follower.orientation	= glm::normalize( ancestor.orientation * offset.orientation );
+
+		matrix			= glm::toMat4( follower.orientation );
+		matrix[3][0]	= follower.position.x;
+		matrix[3][1]	= follower.position.y;
+		matrix[3][2]	= follower.position.z;
 	}
 }
 /*
@@ -376,9 +1055,22 @@ MD5Model::Render
 */
 void MD5Model::Render( Program* program ) {
 
-    if ( skinningType == GPU_SKINNING ) {
-        UpdateMatrixTextureBuffer();
-    }
+    if ( skinningType == GPU_SKINNING && bakedPaletteValid ) {
+		UploadBakedPalette();
+	} else if ( skinningType == GPU_SKINNING ) {
+		if ( poseCache == NULL || !poseCache->BindPalette( sharedPoseEntry, sharedPoseFrame, inverseBoneMatricies ) ) {
+			UpdateMatrixTextureBuffer();
+		}
+    } else if ( skinningType == GPU_BAKED_SKINNING ) {
+		BindAnimationTexture( program );
+	} else if ( skinningType == GPU_DUAL_QUATERNION_SKINNING ) {
+		UploadDualQuaternionPalette();
+	} else if ( skinningType == CPU_SKINNING ) {
+		for ( MD5Meshes::iterator currentMesh = meshes.begin();
+			  currentMesh != meshes.end(); ++currentMesh ) {
+			( *currentMesh )->UploadSkinnedVerticies();
+		}
+	}
 
 	program->SetUniform( "uModelMatrix", &modelMatrix[0][0], 16 );
 	program->SetUniform( "uMatColor", &materialColor[0], 3 );
@@ -393,47 +1085,540 @@ void MD5Model::Render( Program* program ) {
 MD5Model::UpdateMatrixTextureBuffer
 
 	Updates the matrix texture buffer on the GPU.
+	Only the active joints are packed, in palette order,
+	and the whole palette is uploaded in one call.
 =============
 */
 void MD5Model::UpdateMatrixTextureBuffer( void ) {
+	if ( uploadedPoseVersion != poseVersion ) {
+		paletteUpload.resize( activeJoints.size() * PALETTE_MATRIX_FLOATS );
+		for ( unsigned paletteIndex = 0; paletteIndex < activeJoints.size(); ++paletteIndex ) {
+			unsigned jointIndex = activeJoints[paletteIndex];
+			PackPaletteMatrix( pose.jointMatricies[jointIndex] * inverseBoneMatricies[jointIndex], &paletteUpload[paletteIndex * PALETTE_MATRIX_FLOATS] );
+		}
 
-    const Skeleton* currentSkeleton = &animation1->GetCurrentSkeleton();
-	if ( animation2 ) {
-		if ( animation1 != animation2 && blendAmount != 0.0f ) {
-			if ( blendAmount > 0.99f ) {
-				currentSkeleton = &animation2->GetCurrentSkeleton();
-			} else {
-				currentSkeleton = &blendSkeleton;
-			}
+		glBindBuffer( GL_TEXTURE_BUFFER, matrixBufferName );
+		glBufferSubData( GL_TEXTURE_BUFFER, 0, sizeof( float ) * paletteUpload.size(), &paletteUpload[0] );
+		uploadedPoseVersion = poseVersion;
+	}
+
+	BindMatrixTextureBuffer();
+}
+/*
+=============
+MD5Model::UploadBakedPalette
+
+	Uploads the sampled baked palette in one call, it's
+	already packed the way the matrix buffer is.
+	Skipped if the buffer already holds it.
+=============
+*/
+void MD5Model::UploadBakedPalette( void ) {
+	if ( uploadedPoseVersion != poseVersion ) {
+		glBindBuffer( GL_TEXTURE_BUFFER, matrixBufferName );
+		glBufferSubData( GL_TEXTURE_BUFFER, 0, sizeof( float ) * bakedPalette.size(), &bakedPalette[0] );
+		uploadedPoseVersion = poseVersion;
+	}
+
+	BindMatrixTextureBuffer();
+}
+/*
+=============
+MD5Model::UploadDualQuaternionPalette
+
+	Packs a dual quaternion per active joint, in palette order,
+	into the matrix buffer and uploads it in one call.
+	Each bone is 2 texels instead of a matrix's 3.
+=============
+*/
+void MD5Model::UploadDualQuaternionPalette( void ) {
+	if ( uploadedPoseVersion != poseVersion ) {
+		paletteUpload.resize( activeJoints.size() * DUAL_QUATERNION_FLOATS );
+		for ( unsigned paletteIndex = 0; paletteIndex < activeJoints.size(); ++paletteIndex ) {
+			unsigned				jointIndex	= activeJoints[paletteIndex];
+			const SkeletonJoint&	poseJoint	= pose.joints[jointIndex];
+			DualQuaternion			skinning	= MakeSkinningDualQuaternion( poseJoint.orientation, poseJoint.position, joints[jointIndex].orientation, joints[jointIndex].position );
+
+			float* packed = &paletteUpload[paletteIndex * DUAL_QUATERNION_FLOATS];
+			memcpy( &packed[0], &skinning.real[0], sizeof( float ) * 4 );
+			memcpy( &packed[4], &skinning.dual[0], sizeof( float ) * 4 );
 		}
+
+		glBindBuffer( GL_TEXTURE_BUFFER, matrixBufferName );
+		glBufferSubData( GL_TEXTURE_BUFFER, 0, sizeof( float ) * paletteUpload.size(), &paletteUpload[0] );
+		uploadedPoseVersion = poseVersion;
 	}
 
-    glBindBuffer( GL_TEXTURE_BUFFER, matrixBufferName );
-    unsigned index = 0;
-    for ( SkeletonMatricies::const_iterator currentMatrix = currentSkeleton->jointMatricies.begin();
-          currentMatrix != currentSkeleton->jointMatricies.end(); ++currentMatrix, ++index ) {
-        glBufferSubData( GL_TEXTURE_BUFFER, index * 16 * sizeof( float ), sizeof( float ) * 16, &( *currentMatrix * inverseBoneMatricies[index] )[0] );        
-    }
+	BindMatrixTextureBuffer();
+}
+/*
+=============
+MD5Model::BindMatrixTextureBuffer
 
+	Points the matrix texture at this model's matrix buffer.
+	Done every frame, the texture is shared by every model.
+=============
+*/
+void MD5Model::BindMatrixTextureBuffer( void ) {
     glActiveTexture( GL_TEXTURE1 );
     glBindTexture( GL_TEXTURE_2D, matrixTextureName );
     glTexBuffer( GL_TEXTURE_BUFFER, GL_RGBA32F, matrixBufferName );
 }
 /*
 =============
+MD5Model::GetBakedPaletteClip
+
+	Returns the clip to sample baked palettes from, NULL if
+	the playing layers need a full blend. Only GPU skinning
+	of a single full weight clip is baked.
+=============
+*/
+const MD5Animation* MD5Model::GetBakedPaletteClip( void ) const {
+	if ( !paletteBakingEnabled || skinningType != GPU_SKINNING || blendLayers.size() != 1 ) {
+		return NULL;
+	}
+
+	const AnimationBlendInput& layer = blendLayers[0];
+	if ( layer.clip == NULL || layer.mask != NULL || layer.additive || layer.weight <= 0.0f ||
+		 !layer.clip->HasBakedPalettes() || layer.clip->GetBakedJointCount() != activeJoints.size() ) {
+		return NULL;
+	}
+
+	return layer.clip;
+}
+/*
+=============
+MD5Model::SetPaletteBakingEnabled
+
+	Bakes the skinning palettes of every keyframe of every clip,
+	or frees them.
+=============
+*/
+void MD5Model::SetPaletteBakingEnabled( bool enabled ) {
+	paletteBakingEnabled	= enabled;
+	bakedPaletteValid		= false;
+	InvalidatePose();
+	MarkPoseChanged();
+
+	for ( MD5Animations::iterator currentAnim = animations.begin();
+		  currentAnim != animations.end(); ++currentAnim ) {
+		if ( paletteBakingEnabled ) {
+			( *currentAnim )->BakePalettes( activeJoints, inverseBoneMatricies );
+		} else {
+			( *currentAnim )->ReleaseBakedPalettes();
+		}
+	}
+}
+/*
+=============
+MD5Model::GetBakedPaletteMemory
+
+	Bytes used by the baked palettes of all the clips.
+=============
+*/
+unsigned MD5Model::GetBakedPaletteMemory( void ) const {
+	unsigned bytes = 0;
+	for ( MD5Animations::const_iterator currentAnim = animations.begin();
+		  currentAnim != animations.end(); ++currentAnim ) {
+		bytes += ( *currentAnim )->GetBakedPaletteMemory();
+	}
+	return bytes;
+}
+/*
+=============
+MD5Model::BuildAnimationTexture
+
+	Uploads the baked palettes of every clip into one texture buffer,
+	three texels per bone per keyframe. The GPU_BAKED_SKINNING shader
+	samples and interpolates the keyframes itself.
+	Clips that weren't baked are baked for the upload and freed again.
+=============
+*/
+bool MD5Model::BuildAnimationTexture( void ) {
+	ReleaseAnimationTexture();
+
+	std::vector<float> texels;
+	animationTextureOffsets.assign( animations.size(), -1 );
+
+	for ( unsigned i = 0; i < animations.size(); ++i ) {
+		MD5Animation* clip		= animations[i];
+		bool		  bakedHere	= !clip->HasBakedPalettes() || clip->GetBakedJointCount() != activeJoints.size();
+
+		if ( bakedHere && !clip->BakePalettes( activeJoints, inverseBoneMatricies ) ) {
+			continue;
+		}
+
+		animationTextureOffsets[i] = texels.size() / 4;
+		texels.insert( texels.end(), clip->GetBakedPalettes().begin(), clip->GetBakedPalettes().end() );
+
+		if ( bakedHere && !paletteBakingEnabled ) {
+			clip->ReleaseBakedPalettes();
+		}
+	}
+
+	if ( texels.empty() ) {
+		return false;
+	}
+
+	GLint maxTexels = 0;
+	glGetIntegerv( GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels );
+	if ( texels.size() / 4 > ( unsigned )maxTexels ) {
+		printf( "Animation texture for '%s' needs %u texels, the limit is %i\n", modelName.c_str(), ( unsigned )( texels.size() / 4 ), maxTexels );
+		return false;
+	}
+
+	glGenBuffers( 1, &animationBufferName );
+	glGenTextures( 1, &animationTextureName );
+	if ( animationBufferName == 0 || animationTextureName == 0 ) {
+		printf( "Could not create animation texture\n" );
+		ReleaseAnimationTexture();
+		return false;
+	}
+
+	animationTextureSize = texels.size() * sizeof( float );
+
+	glBindBuffer( GL_TEXTURE_BUFFER, animationBufferName );
+	glBufferData( GL_TEXTURE_BUFFER, animationTextureSize, &texels[0], GL_STATIC_DRAW );
+	glBindTexture( GL_TEXTURE_BUFFER, animationTextureName );
+	glTexBuffer( GL_TEXTURE_BUFFER, GL_RGBA32F, animationBufferName );
+	glBindTexture( GL_TEXTURE_BUFFER, 0 );
+	glBindBuffer( GL_TEXTURE_BUFFER, 0 );
+
+	return true;
+}
+/*
+=============
+MD5Model::ReleaseAnimationTexture
+
+	Frees the animation texture.
+=============
+*/
+void MD5Model::ReleaseAnimationTexture( void ) {
+	if ( animationTextureName != 0 ) {
+		glDeleteTextures( 1, &animationTextureName );
+		animationTextureName = 0;
+	}
+	if ( animationBufferName != 0 ) {
+		glDeleteBuffers( 1, &animationBufferName );
+		animationBufferName = 0;
+	}
+	animationTextureOffsets.clear();
+	animationTextureSize = 0;
+}
+/*
+=============
+MD5Model::BindAnimationTexture
+
+	Binds the animation texture and sets the playback
+	uniforms of the first layer's clip.
+	The offsets are empty if the last build failed.
+=============
+*/
+void MD5Model::BindAnimationTexture( Program* program ) {
+	const MD5Animation* clip		= ( blendLayers.empty() ) ? NULL : blendLayers[0].clip;
+	int					clipOffset	= -1;
+
+	unsigned clipIndex = std::find( animations.begin(), animations.end(), clip ) - animations.begin();
+	if ( clipIndex < animationTextureOffsets.size() ) {
+		clipOffset = animationTextureOffsets[clipIndex];
+	}
+
+	if ( clipOffset < 0 ) { //Clip isn't in the texture, hold the first keyframe in it
+		program->SetUniform( "uAnimationTime", 0.0f );
+		program->SetUniform( "uFrameCount", 1 );
+		program->SetUniform( "uClipOffset", 0 );
+	} else {
+		program->SetUniform( "uAnimationTime", blendLayers[0].time );
+		program->SetUniform( "uFrameRate", ( float )clip->GetFrameRate() );
+		program->SetUniform( "uFrameCount", ( int )clip->GetFrameCount() );
+		program->SetUniform( "uClipOffset", clipOffset );
+		program->SetUniform( "uLoop", ( clip->GetWrapMode() == ANIMATION_WRAP_LOOP ) ? 1 : 0 );
+	}
+	program->SetUniform( "uJointCount", ( int )activeJoints.size() );
+	program->SetUniform( "uAnimationBuffer", 2 );
+
+	glActiveTexture( GL_TEXTURE2 );
+	glBindTexture( GL_TEXTURE_BUFFER, animationTextureName );
+}
+/*
+=============
 MD5Model::SetSkinningType
 
 	Sets the skinning type.
+	GPU resident models read their mesh data back in before CPU skinning.
 =============
 */
 void MD5Model::SetSkinningType( ModelSkinningType type ) {
-	skinningType = type;
-	if ( skinningType == GPU_SKINNING ) {
+	if ( type == GPU_BAKED_SKINNING && animationTextureName == 0 && !BuildAnimationTexture() ) {
+		printf( "Animation texture could not be built, using GPU skinning\n" );
+		type = GPU_SKINNING;
+	}
+
+	if ( type == CPU_SKINNING && !RestoreMeshData() ) {
+		printf( "Mesh data could not be restored, staying on GPU skinning\n" );
+		return;
+	}
+
+	skinningType		= type;
+	uploadedPoseVersion	= 0; //Matricies and dual quaternions share the matrix buffer
+	InvalidatePose(); //GPU_BAKED_SKINNING leaves the pose behind
+	if ( skinningType != CPU_SKINNING ) {
 		for ( MD5Meshes::iterator currentMesh = meshes.begin();
 			  currentMesh != meshes.end(); ++currentMesh++ ) {
 			( *currentMesh )->SetVertexBufferToBindPose(); //Do this or it looks crazy.
 		}    
+		skinnedPoseVersion = 0;
+
+		if ( gpuResident ) {
+			ReleaseMeshData();
+		}
+	} else if ( skinnedPoseVersion != poseVersion ) {
+		SkinMeshesOnCPU();
+	}
+}
+/*
+=============
+MD5Model::SetCPUSkinningMode
+
+	Sets how the meshes are skinned while CPU skinning.
+	The meshes are reskinned so the change shows while paused.
+=============
+*/
+void MD5Model::SetCPUSkinningMode( CPUSkinningMode mode ) {
+	cpuSkinningMode = mode;
+	if ( skinningType == CPU_SKINNING ) {
+		SkinMeshesOnCPU();
+	}
+}
+/*
+=============
+MD5Model::MeasurePaletteError
+
+	Compares 4 bone palette skinning of the current pose with
+	skinning from every weight. The errors are distances
+	between the skinned positions, in model units.
+	Returns false if the meshes have no CPU data.
+=============
+*/
+bool MD5Model::MeasurePaletteError( float& maxError, float& averageError ) {
+	BuildCPUPalette();
+
+	float		totalError		= 0.0f;
+	unsigned	measuredCount	= 0;
+	maxError = 0.0f;
+	for ( MD5Meshes::const_iterator currentMesh = meshes.begin();
+		  currentMesh != meshes.end(); ++currentMesh ) {
+		measuredCount += ( *currentMesh )->MeasurePaletteError( pose, &cpuPalette[0], maxError, totalError );
+	}
+
+	averageError = ( measuredCount > 0 ) ? totalError / measuredCount : 0.0f;
+	return measuredCount > 0;
+}
+/*
+=============
+MD5Model::BenchmarkCPUSkinning
+
+	Skins the current pose iterations times in mode and sets
+	milliseconds to the average time of one skin, building the
+	palette included. The job system is used if it's set.
+	Returns false if the meshes have no CPU data.
+=============
+*/
+bool MD5Model::BenchmarkCPUSkinning( CPUSkinningMode mode, unsigned iterations, float& milliseconds ) {
+	for ( MD5Meshes::const_iterator currentMesh = meshes.begin();
+		  currentMesh != meshes.end(); ++currentMesh ) {
+		if ( !( *currentMesh )->HasCPUData() ) {
+			return false;
+		}
+	}
+
+	CPUSkinningMode currentMode = cpuSkinningMode;
+	cpuSkinningMode = mode;
+
+	double startTime = GetTimeMilliseconds();
+	for ( unsigned i = 0; i < iterations; ++i ) {
+		SkinMeshesOnCPU();
+	}
+	milliseconds = ( float )( ( GetTimeMilliseconds() - startTime ) / std::max( iterations, 1u ) );
+
+	//Put back what the current mode would have skinned
+	cpuSkinningMode		= currentMode;
+	skinnedPoseVersion	= 0;
+	if ( skinningType == CPU_SKINNING ) {
+		SkinMeshesOnCPU();
+	}
+
+	return true;
+}
+/*
+=============
+MD5Model::SetGPUResident
+
+	When enabled the meshes only keep their data on the GPU while the
+	model is GPU skinned. It's read back from the source file if the
+	model switches to CPU skinning.
+=============
+*/
+void MD5Model::SetGPUResident( bool enabled ) {
+	gpuResident = enabled;
+
+	if ( gpuResident && skinningType != CPU_SKINNING ) {
+		ReleaseMeshData();
+	} else if ( !gpuResident && !RestoreMeshData() ) {
+		printf( "Mesh data for '%s' could not be restored\n", modelName.c_str() );
+	}
+}
+/*
+=============
+MD5Model::GetMeshMemory
+
+	Returns the bytes of CPU memory held by the meshes.
+=============
+*/
+unsigned MD5Model::GetMeshMemory( void ) const {
+	unsigned memory = 0;
+	for ( MD5Meshes::const_iterator currentMesh = meshes.begin();
+		  currentMesh != meshes.end(); ++currentMesh ) {
+		memory += ( *currentMesh )->GetCPUMemory();
 	}
+	return memory;
+}
+/*
+=============
+MD5Model::GetMemoryUsage
+
+	Returns the memory held by the model, its meshes, textures and clips.
+=============
+*/
+MemoryUsage MD5Model::GetMemoryUsage( void ) const {
+	MemoryReport report;
+	BuildMemoryReport( report );
+
+	MemoryUsage usage;
+	for ( MemoryReport::const_iterator entry = report.begin();
+		  entry != report.end(); ++entry ) {
+		usage += entry->usage;
+	}
+	return usage;
+}
+/*
+=============
+MD5Model::BuildMemoryReport
+
+	Adds an entry for the model and each of its meshes, textures and clips.
+=============
+*/
+void MD5Model::BuildMemoryReport( MemoryReport& report ) const {
+	report.push_back( MemoryReportEntry( "Model", modelName, GetOwnMemoryUsage() ) );
+
+	for ( unsigned meshIndex = 0; meshIndex < meshes.size(); ++meshIndex ) {
+		const MD5Mesh* currentMesh = meshes[meshIndex];
+		report.push_back( MemoryReportEntry( "Mesh", modelName + " #" + std::to_string( meshIndex ), currentMesh->GetMemoryUsage() ) );
+
+		MemoryUsage textureUsage = currentMesh->GetTextureMemoryUsage();
+		if ( textureUsage.cpuBytes > 0 ) {
+			report.push_back( MemoryReportEntry( "Texture", currentMesh->GetShaderName(), textureUsage ) );
+		}
+	}
+
+	for ( MD5Animations::const_iterator currentAnim = animations.begin();
+		  currentAnim != animations.end(); ++currentAnim ) {
+		report.push_back( MemoryReportEntry( "Clip", ( *currentAnim )->GetAnimationName(), ( *currentAnim )->GetMemoryUsage() ) );
+	}
+}
+/*
+=============
+MD5Model::GetOwnMemoryUsage
+
+	Returns the memory held by the model itself.
+	Skeleton, poses, joint tables, palettes and the matrix and animation buffers.
+=============
+*/
+MemoryUsage MD5Model::GetOwnMemoryUsage( void ) const {
+	size_t cpuBytes = sizeof( MD5Model ) + VectorMemory( joints ) + VectorMemory( meshes ) + VectorMemory( inverseBoneMatricies ) +
+					  VectorMemory( activeJoints ) + VectorMemory( jointRemap ) + requestedJoints.capacity() / 8 +
+					  SkeletonMemory( lodPreviousPose ) + SkeletonMemory( lodNextPose ) +
+					  SkeletonMemory( lastEvaluatedPose ) + SkeletonMemory( previousEvaluatedPose ) + SkeletonMemory( pose ) +
+					  VectorMemory( bakedPalette ) + VectorMemory( paletteUpload ) + VectorMemory( cpuPalette ) + VectorMemory( cpuDualQuaternions ) + VectorMemory( skinningChunks ) + VectorMemory( animationTextureOffsets ) +
+					  VectorMemory( animations ) + VectorMemory( blendLayers ) + VectorMemory( posedLayers );
+
+	for ( unsigned level = 0; level < ANIMATION_LOD_COUNT; ++level ) {
+		cpuBytes += VectorMemory( lodJoints[level] ) + VectorMemory( lodFollowers[level] ) + VectorMemory( lodFollowOffsets[level] );
+	}
+
+	size_t gpuBytes = activeJoints.size() * PALETTE_MATRIX_FLOATS * sizeof( float ) + animationTextureSize;
+
+	return MemoryUsage( cpuBytes, gpuBytes );
+}
+/*
+=============
+MD5Model::ReleaseMeshData
+
+	Frees the CPU side data of every mesh.
+=============
+*/
+void MD5Model::ReleaseMeshData( void ) {
+	for ( MD5Meshes::iterator currentMesh = meshes.begin();
+		  currentMesh != meshes.end(); ++currentMesh ) {
+		( *currentMesh )->ReleaseCPUData();
+	}
+	skinnedPoseVersion = 0;
+}
+/*
+=============
+MD5Model::RestoreMeshData
+
+	Reads the CPU side data of released meshes back from sourcePath.
+	Meshes are matched to the file's mesh blocks in order.
+	Returns true if every mesh has its data.
+=============
+*/
+bool MD5Model::RestoreMeshData( void ) {
+	bool released = false;
+	for ( MD5Meshes::iterator currentMesh = meshes.begin();
+		  currentMesh != meshes.end(); ++currentMesh ) {
+		released = released || !( *currentMesh )->HasCPUData();
+	}
+	if ( !released ) {
+		return true;
+	}
+
+	ArenaAllocator	loadArena;
+	char*			fileData = FileOperations::ReadFileToArena( sourcePath.c_str(), loadArena );
+	if ( fileData == NULL ) {
+		printf( "Mesh at path '%s' could not be reopened\n", sourcePath.c_str() );
+		return false;
+	}
+
+	unsigned meshIndex		= 0;
+	char* nextLineToken		= NULL;
+	char* currentLine		= strtok_s( fileData, "\n", &nextLineToken );
+
+	while ( currentLine != NULL && meshIndex < meshes.size() ) {
+		char* nextParam     = NULL;
+		char* currentParam  = strtok_s( currentLine, " ", &nextParam );
+
+		if ( currentParam != NULL && STRINGS_ARE_EQUAL( currentParam, "mesh" ) ) {
+			char* endPosition = NULL;
+			if ( !meshes[meshIndex]->RestoreCPUData( nextLineToken, joints, &endPosition, loadArena ) ) {
+				printf( "Mesh %u in '%s' could not be restored\n", meshIndex, sourcePath.c_str() );
+				ReleaseMeshData();
+				return false;
+			}
+			nextLineToken = endPosition;
+			++meshIndex;
+		}
+
+		currentLine = strtok_s( NULL, "\n", &nextLineToken );
+	}
+
+	if ( meshIndex < meshes.size() ) {
+		printf( "'%s' has fewer meshes than were loaded\n", sourcePath.c_str() );
+		ReleaseMeshData();
+		return false;
+	}
+
+	return true;
 }
 /*
 =============
@@ -499,7 +1684,9 @@ MD5Model::SetBlendFactor
 =============
 */
 void MD5Model::SetBlendFactor( float newFactor ) {
-	if ( animation1 && animation2 ) {
+	if ( animation1 && animation2 && blendLayers.size() == 2 ) {
 		blendAmount = std::min( std::max( newFactor, 0.0f ), 1.0f );
+		blendLayers[0].weight = 1.0f - blendAmount;
+		blendLayers[1].weight = blendAmount;
 	}
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include "Program.h"
 #include "MD5Mesh.h"
 #include "MD5Animation.h"
+#include "JobSystem.h"
+#include "PoseCache.h"
 
 /*
 ========================
@@ -23,6 +25,7 @@ public:
 	
 	static MD5Model*			CreateMD5ModelWithMesh( const char* path );
 	static MD5Model*			CreateMD5Model( void );
+	static MD5Model*			CreateMD5ModelInstance( const MD5Model* source );
 
 	bool						InitMD5ModelWithMesh( const char* path );
 	
@@ -33,6 +36,7 @@ public:
 
 	void						SetRotation( float angle, glm::vec3 axis );
 	void						RotateAround( float angle, glm::vec3 axis );
+	inline void					SetPosition( const glm::vec3& position ) { modelMatrix[3] = glm::vec4( position, 1.0f ); }
 
 	inline const glm::mat4&		GetModelMatrix( void ) const { return modelMatrix; }    
 	
@@ -40,6 +44,7 @@ public:
 	inline const glm::vec3&		GetMaterial( void ) const { return materialColor; }
 	
     inline const std::string&   GetModelName( void ) const { return modelName; }
+	inline const std::string&	GetSourcePath( void ) const { return sourcePath; }
 	
     inline float				GetBlendFactor( void ) const { return blendAmount; }
 	void						SetBlendFactor( float newFactor );
@@ -47,32 +52,151 @@ public:
 	void						SetSkinningType( ModelSkinningType skType );
     inline ModelSkinningType    GetSkinningType( void ) const { return skinningType; }
 
+	void						SetCPUSkinningMode( CPUSkinningMode mode );
+	inline CPUSkinningMode		GetCPUSkinningMode( void ) const { return cpuSkinningMode; }
+	bool						MeasurePaletteError( float& maxError, float& averageError );
+	bool						BenchmarkCPUSkinning( CPUSkinningMode mode, unsigned iterations, float& milliseconds );
+	inline void					SetSkinningJobSystem( JobSystem* jobSystem ) { skinningJobSystem = jobSystem; }
+	inline JobSystem*			GetSkinningJobSystem( void ) const { return skinningJobSystem; }
+
+	void						SetGPUResident( bool enabled );
+	inline bool					IsGPUResident( void ) const { return gpuResident; }
+	unsigned					GetMeshMemory( void ) const;
+
+	MemoryUsage					GetMemoryUsage( void ) const;
+	void						BuildMemoryReport( MemoryReport& report ) const;
+
     inline unsigned				GetAnimationCount( void ) const { return animations.size(); }	
     std::vector<std::string>	GetPlayingAnimationNames( void ) const;
 	std::vector<int>			GetPlayingAnimationIndicies( void ) const;
 
 	void						PlaySingleAnimation( int animation1Index );
 	void						PlayBlendedAnimation( int animation1Index, int animation2Index, float blendAmount );
+	void						PlayLayeredAnimation( const AnimationBlendInputs& layers );
+	bool						BuildBoneMask( const char* jointName, bool includeChildren, BoneMask& mask ) const;
+
+	bool						RequestJoint( const char* jointName );
+	inline unsigned				GetJointCount( void ) const { return joints.size(); }
+	inline unsigned				GetActiveJointCount( void ) const { return activeJoints.size(); }
+
+	void						SetAnimationLOD( AnimationLODLevel level );
+	void						SelectAnimationLOD( float screenSize );
+	inline AnimationLODLevel	GetAnimationLOD( void ) const { return animationLOD; }
+	inline unsigned				GetLODJointCount( void ) const { return lodJoints[animationLOD].size(); }
+	inline float				GetBoundingRadius( void ) const { return boundingRadius; }
+	float						ComputeScreenSize( const glm::vec3& cameraPosition, float tanHalfFieldOfView ) const;
+
+	inline void					SetPoseCache( PoseCache* cache ) { poseCache = cache; sharedPoseEntry = NULL; }
+	inline PoseCache*			GetPoseCache( void ) const { return poseCache; }
+
+	void						SetPaletteBakingEnabled( bool enabled );
+	inline bool					IsPaletteBakingEnabled( void ) const { return paletteBakingEnabled; }
+	inline bool					IsUsingBakedPalette( void ) const { return bakedPaletteValid; }
+	unsigned					GetBakedPaletteMemory( void ) const;
+
+	bool						BuildAnimationTexture( void );
+	void						ReleaseAnimationTexture( void );
+	inline unsigned				GetAnimationTextureMemory( void ) const { return animationTextureSize; }
+
+	void						SetPoseHistoryEnabled( bool enabled );
+	bool						ExtrapolatePose( float timeSinceUpdate );
+
+	static const AnimationLODSettings AnimationLODTable[ANIMATION_LOD_COUNT];
+
+	inline const AnimationBlendInputs& GetBlendLayers( void ) const { return blendLayers; }
+	inline const Skeleton&		GetPose( void ) const { return pose; }
+	inline unsigned				GetPoseVersion( void ) const { return poseVersion; }
 
 private:
+	/*
+	========================
+
+		SkinningChunk
+
+			A range of one mesh's verticies
+			skinned as a single job.
+
+	========================
+	*/
+	struct SkinningChunk {
+		MD5Mesh*	mesh;
+		unsigned	firstVertex;
+		unsigned	vertexCount;
+	};
+
 								MD5Model( void );	
 	
 	static bool					ValidMD5MeshExtension( const char* path );
 
     bool                        SetupMatrixTextureBuffer( void );
     void                        UpdateMatrixTextureBuffer( void );
+	void						UploadBakedPalette( void );
+	void						UploadDualQuaternionPalette( void );
+	void						BindMatrixTextureBuffer( void );
+	const MD5Animation*			GetBakedPaletteClip( void ) const;
+	void						BindAnimationTexture( Program* program );
 
 	char*						ReadJoints( char* startingPosition );
-	char*						ReadMesh( char* startingPosition );
+	char*						ReadMesh( char* startingPosition, ArenaAllocator& loadArena );
+	void						ReleaseMeshData( void );
+	MemoryUsage					GetOwnMemoryUsage( void ) const;
+	bool						RestoreMeshData( void );
 	void						ReadJoint( char* startingPosition, Joint& dest );    
     void                        GenerateBindPoseMatricies( void );
+	void						UpdateActiveJoints( void );
+	void						BuildLODJointSets( void );
+	void						EvaluatePose( Skeleton& destination );
+	void						ApplyLODFollowers( Skeleton& destination ) const;
+	void						BuildCPUPalette( void );
+	void						BuildCPUDualQuaternions( void );
+	void						SkinMeshesOnCPU( void );
+	void						BuildSkinningChunks( void );
+	void						MarkPoseChanged( void );
+	inline void					InvalidatePose( void ) { posedLOD = ANIMATION_LOD_COUNT; }
 
     std::string                 modelName;
+	std::string					sourcePath;
 
 	Joints						joints;
     MD5Meshes					meshes;
     std::vector<glm::mat4>      inverseBoneMatricies;
 
+	JointIndicies				activeJoints;		//Joints something depends on, sorted
+	std::vector<int>			jointRemap;			//Joint index to palette index, -1 if pruned
+	std::vector<bool>			requestedJoints;	//Joints kept for attachments
+
+	AnimationLODLevel			animationLOD;
+	JointIndicies				lodJoints[ANIMATION_LOD_COUNT];			//Joints evaluated at each LOD
+	JointIndicies				lodFollowers[ANIMATION_LOD_COUNT];		//Active joints skipped at each LOD
+	SkeletonJoints				lodFollowOffsets[ANIMATION_LOD_COUNT];	//Bind offset of each follower from the evaluated ancestor in parentID
+	Skeleton					lodPreviousPose;
+	Skeleton					lodNextPose;
+	float						lodTimer;
+	bool						lodPosesValid;
+	float						boundingRadius;
+
+	bool						poseHistoryEnabled;
+	Skeleton					lastEvaluatedPose;
+	Skeleton					previousEvaluatedPose;
+	float						poseHistoryInterval;	//Time between the last two evaluated poses
+	unsigned					poseHistoryCount;
+
+	PoseCache*					poseCache;
+	PoseCacheKey				poseCacheKey;		//Reused between lookups
+	AnimationBlendInputs		poseCacheInputs;	//Blend layers snapped to the cache key
+	PoseCacheEntry*				sharedPoseEntry;	//Set when pose is exactly the cached pose
+	unsigned					sharedPoseFrame;
+
+	bool						paletteBakingEnabled;
+	bool						bakedPaletteValid;	//bakedPalette holds this frame's skinning matricies
+	std::vector<float>			bakedPalette;		//Packed 3x4 matricies in palette order
+	std::vector<float>			paletteUpload;		//Packed 3x4 matricies of the pose, staged for the matrix buffer
+
+	GLuint						animationBufferName;		//Every clip's baked palettes for GPU_BAKED_SKINNING
+	GLuint						animationTextureName;
+	std::vector<int>			animationTextureOffsets;	//First texel of each clip, -1 if it couldn't be baked
+	unsigned					animationTextureSize;
+
 	bool						animate;
 	int							animation1Index;
 	int							animation2Index;
@@ -84,12 +208,24 @@ private:
 	glm::vec3					materialColor;
 
 	MD5Animations				animations;
-	Skeleton					blendSkeleton;
+	AnimationBlendInputs		blendLayers;
+	Skeleton					pose;
+	unsigned					poseVersion;			//Bumped whenever pose or bakedPalette changes
+	unsigned					skinnedPoseVersion;		//poseVersion the CPU skinned verticies were built from
+	unsigned					uploadedPoseVersion;	//poseVersion held by matrixBufferName
+	AnimationBlendInputs		posedLayers;			//blendLayers when pose was last evaluated
+	AnimationLODLevel			posedLOD;				//ANIMATION_LOD_COUNT when pose must be evaluated
 	
 	MD5Animation*				animation1;
 	MD5Animation*				animation2;
 
     ModelSkinningType           skinningType;
+	bool						gpuResident;		//Mesh data only kept on the GPU while GPU skinning
+	CPUSkinningMode				cpuSkinningMode;
+	std::vector<glm::mat4>		cpuPalette;			//Joint matrix times inverse bind matrix, indexed by joint
+	std::vector<DualQuaternion>	cpuDualQuaternions;	//cpuPalette as dual quaternions
+	JobSystem*					skinningJobSystem;	//Splits CPU skinning into chunks when set
+	std::vector<SkinningChunk>	skinningChunks;		//Every mesh's verticies in CPU_SKINNING_CHUNK_VERTICIES ranges
 };
 
 #endif //__MD5MODEL_H__
\ No newline at end of file
@@ -10,7 +10,43 @@
 
 enum ModelSkinningType {
     CPU_SKINNING,
-    GPU_SKINNING        
+    GPU_SKINNING,
+	GPU_BAKED_SKINNING,				//Keyframes sampled by the vertex shader from an animation texture
+	GPU_DUAL_QUATERNION_SKINNING,	//4 bone dual quaternion palette, 2 texels per bone
+	MODEL_SKINNING_TYPE_COUNT
+};
+
+enum CPUSkinningMode {
+	CPU_SKINNING_ALL_WEIGHTS,	//Every MD5 weight with its own offset position
+	CPU_SKINNING_PALETTE,		//The GPU's 4 bone matrix palette over the bind pose
+	CPU_SKINNING_DUAL_QUATERNION,	//The GPU's 4 bone dual quaternion palette over the bind pose
+	CPU_SKINNING_MODE_COUNT
+};
+
+enum AnimationLODLevel {
+	ANIMATION_LOD_FULL,
+	ANIMATION_LOD_REDUCED,
+	ANIMATION_LOD_MINIMAL,
+	ANIMATION_LOD_FROZEN,
+	ANIMATION_LOD_COUNT
+};
+/*
+========================
+
+	AnimationLODSettings
+
+		How an animation LOD level is evaluated.
+		minScreenSize is the projected radius as a
+		fraction of half the screen height.
+		Joints with less than minJointInfluence of the
+		most influential joint's weight follow their parent.
+
+========================
+*/
+struct AnimationLODSettings {
+	float	minScreenSize;
+	float	updateInterval;
+	float	minJointInfluence;
 };
 /*
 ========================
@@ -38,38 +74,106 @@ typedef std::vector<Joint> Joints;
 /*
 ========================
 
-	Vertex
+	VertexWeightRange
 
-		Info about a single vertex.
+		The weights a vertex is skinned with.
 
 ========================
 */
-struct Vertex {
-    unsigned    vertexIndex;
+struct VertexWeightRange {
     unsigned    startWeight;
     unsigned    countWeight;
 
+    VertexWeightRange() :
+        startWeight( 0 ),
+        countWeight( 0 )
+    {}
+};
+typedef std::vector<VertexWeightRange> VertexWeightRanges;
+/*
+========================
+
+	VertexWeightBucket
+
+		A run of verticies that all have
+		countWeight weights.
+
+========================
+*/
+struct VertexWeightBucket {
+    unsigned    firstVertex;
+    unsigned    vertexCount;
+    unsigned    countWeight;
+
+    VertexWeightBucket() :
+        firstVertex( 0 ),
+        vertexCount( 0 ),
+        countWeight( 0 )
+    {}
+};
+typedef std::vector<VertexWeightBucket> VertexWeightBuckets;
+/*
+========================
+
+	VertexBindData
+
+		Bind pose info for a single vertex.
+		Only needed while the vertex buffer is built.
+
+========================
+*/
+struct VertexBindData {
     glm::vec2   textureCoordinate;
     glm::vec3   bindPosition;
     glm::vec3   bindNormal;
-    glm::vec3   jointNormal;
-    glm::vec3   gpuNormal;
-    glm::vec4   boneWeights;
-    glm::vec4	boneIndicies;
 
-    Vertex() :
-        vertexIndex( 0 ),
-        startWeight( 0 ),
-        countWeight( 0 ),
+    VertexBindData() :
         textureCoordinate( 0.0f ),
         bindPosition( 0.0f ),
-        bindNormal( 0.0f ),
-		jointNormal( 0.0f ),
-        boneWeights( 0.0f ),
-        boneIndicies( 0.0f )
+        bindNormal( 0.0f )
     {}
 };
-typedef std::vector<Vertex> Verticies;
+/*
+========================
+
+	PackedBindVertex
+
+		Bind pose position and normal read by GPU skinning.
+		The normal is packed as GL_INT_2_10_10_10_REV.
+
+========================
+*/
+struct PackedBindVertex {
+	glm::vec3	position;
+	GLuint		normal;
+
+	PackedBindVertex() :
+		position( 0.0f ),
+		normal( 0 )
+	{}
+};
+/*
+========================
+
+	PackedStaticVertex
+
+		The vertex attributes that never change.
+		The texture coordinate is 2 half floats, the top
+		4 bone weights are unorm8 and sum to 255.
+		Bone indicies live in their own stream.
+
+========================
+*/
+struct PackedStaticVertex {
+	GLuint		textureCoordinate;
+	GLubyte		boneWeights[4];
+
+	PackedStaticVertex() :
+		textureCoordinate( 0 )
+	{
+		boneWeights[0] = boneWeights[1] = boneWeights[2] = boneWeights[3] = 0;
+	}
+};
 /*
 ========================
 
@@ -80,12 +184,9 @@ typedef std::vector<Vertex> Verticies;
 ========================
 */
 struct Triangle {
-    unsigned    triIndex;
     GLuint      indices[3];
 
-    Triangle( void ) :
-        triIndex( 0 )
-    {
+    Triangle( void ) {
         memset( &indices[0], 0, sizeof( GLuint ) * 3 );
     }
 };
@@ -100,13 +201,11 @@ typedef std::vector<Triangle> Triangles;
 ========================
 */
 struct Weight {
-    unsigned    weightIndex;
     unsigned    joint;
     float       bias;
     glm::vec3   position;
 
     Weight( void ) :
-        weightIndex( 0 ),
         joint( 0 ),
         bias( 0.0f )
     {}
@@ -116,5 +215,20 @@ struct Weight {
 	}
 };
 typedef std::vector<Weight> Weights;
+/*
+========================
+
+	MeshJointInfluence
+
+		Total bias a joint has across a mesh.
+		Kept after the weights are released.
+
+========================
+*/
+struct MeshJointInfluence {
+	unsigned	joint;
+	float		bias;
+};
+typedef std::vector<MeshJointInfluence> MeshJointInfluences;
 
 #endif //__MD5MODELCOMPONENTS_H__
\ No newline at end of file
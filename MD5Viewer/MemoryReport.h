@@ -0,0 +1,82 @@
+#ifndef __MEMORYREPORT_H__
+#define __MEMORYREPORT_H__
+
+#include <string>
+#include <vector>
+#include "MD5AnimationStructs.h"
+
+/*
+========================
+
+	MemoryUsage
+
+		Bytes held in CPU memory and an
+		estimate of the bytes held by OpenGL.
+
+========================
+*/
+struct MemoryUsage {
+	size_t	cpuBytes;
+	size_t	gpuBytes;
+
+	MemoryUsage( void ) :
+		cpuBytes( 0 ),
+		gpuBytes( 0 )
+	{}
+
+	MemoryUsage( size_t cpuBytes, size_t gpuBytes ) :
+		cpuBytes( cpuBytes ),
+		gpuBytes( gpuBytes )
+	{}
+
+	MemoryUsage& operator+=( const MemoryUsage& usage ) {
+		cpuBytes += usage.cpuBytes;
+		gpuBytes += usage.gpuBytes;
+		return *this;
+	}
+};
+/*
+========================
+
+	MemoryReportEntry
+
+		The memory used by one part of a model.
+		category is "Model", "Mesh", "Texture" or "Clip".
+
+========================
+*/
+struct MemoryReportEntry {
+	std::string	category;
+	std::string	name;
+	MemoryUsage	usage;
+
+	MemoryReportEntry( const std::string& category, const std::string& name, const MemoryUsage& usage ) :
+		category( category ),
+		name( name ),
+		usage( usage )
+	{}
+};
+typedef std::vector<MemoryReportEntry> MemoryReport;
+/*
+=============
+VectorMemory
+
+	Bytes reserved by a vector's storage.
+=============
+*/
+template<typename T>
+inline size_t VectorMemory( const std::vector<T>& values ) {
+	return values.capacity() * sizeof( T );
+}
+/*
+=============
+SkeletonMemory
+
+	Bytes reserved by a skeleton's joints and matricies.
+=============
+*/
+inline size_t SkeletonMemory( const Skeleton& skeleton ) {
+	return VectorMemory( skeleton.joints ) + VectorMemory( skeleton.jointMatricies );
+}
+
+#endif //__MEMORYREPORT_H__
@@ -1,6 +1,30 @@
 #include "ModelViewer.h"
 #include "TextureManager.h"
 
+//Vertical field of view of the main camera, in degrees
+#define VIEWER_FIELD_OF_VIEW			45.0f
+//CPU time per frame the animation scheduler may spend on updates
+#define VIEWER_ANIMATION_BUDGET			2.0f
+//How often the model info text is rebuilt while animating
+#define VIEWER_INFO_REFRESH_INTERVAL	0.25f
+//Playback phases closer than this share a cached pose
+#define VIEWER_POSE_CACHE_QUANTUM		( 1.0f / 30.0f )
+//Skins timed per CPU skinning mode by the skinning benchmark
+#define VIEWER_BENCHMARK_ITERATIONS		100
+//Models in crowd mode, the current model included
+#define VIEWER_CROWD_SIZE				16
+//Crowd instances per row, the rows are placed behind the current model
+#define VIEWER_CROWD_COLUMNS			5
+//Distance between crowd instances
+#define VIEWER_CROWD_SPACING			80.0f
+//Crowd instances are started at this many playback phases, instances sharing a phase share cached poses
+#define VIEWER_CROWD_PHASES				4
+//Time between crowd playback phases, in seconds
+#define VIEWER_CROWD_PHASE_STEP			0.25f
+
+static const char* SkinningTypeNames[MODEL_SKINNING_TYPE_COUNT] = { "CPU Skinning", "GPU Skinning", "GPU Animation Texture", "GPU Dual Quaternion" };
+static const char* CPUSkinningModeNames[CPU_SKINNING_MODE_COUNT] = { "All Weights", "4 Bone Palette", "Dual Quaternion" };
+
 /*
 =============
 ModelViewer::ModelViewer
@@ -11,17 +35,36 @@ ModelViewer::ModelViewer
 ModelViewer::ModelViewer( void ) :
 	mainCamera( NULL ),
 	currentModel( NULL ),
+	crowdEnabled( false ),
+	jobSystem( NULL ),
+	animationScheduler( NULL ),
+	poseCache( NULL ),
+	poseCacheEnabled( false ),
+	parallelSkinningEnabled( true ),
+	memoryDumpEnabled( false ),
+	memoryReportVisible( false ),
     currentModelText( NULL ),
     consolasFont( NULL ),
 	projectionMatrix( 1.0 ),
 	CPUSkinningProgram( 0 ),
     GPUSkinningProgram( 0 ),
+    GPUAnimationProgram( 0 ),
+    GPUDualQuaternionProgram( 0 ),
     textProgram( 0 ),
 	animateModel( true ), 
+	animationLODEnabled( true ),
     modelIndex( 0 ),
+	infoRefreshTimer( 0.0f ),
 	screenHeight( 0.0f ),
-	screenWidth( 0.0f )
-{}
+	screenWidth( 0.0f ),
+	renderTimerQuery( 0 ),
+	renderTimerPending( false ),
+	renderTimerSkinningType( CPU_SKINNING )
+{
+	for ( unsigned type = 0; type < MODEL_SKINNING_TYPE_COUNT; ++type ) {
+		renderMilliseconds[type] = 0.0f;
+	}
+}
 /*
 =============
 ModelViewer::~ModelViewer
@@ -45,8 +88,12 @@ void ModelViewer::initialize( int w, int h ) {
 
 	CPUSkinningProgram  = Program::CreateProgram( "assets/shaders/CPULightingVertex.glsl", "assets/shaders/LightingFragment.glsl" );
     GPUSkinningProgram  = Program::CreateProgram( "assets/shaders/GPULightingVertex.glsl", "assets/shaders/LightingFragment.glsl" );
+    GPUAnimationProgram = Program::CreateProgram( "assets/shaders/GPUAnimationVertex.glsl", "assets/shaders/LightingFragment.glsl" );
+    GPUDualQuaternionProgram = Program::CreateProgram( "assets/shaders/GPUDualQuaternionVertex.glsl", "assets/shaders/LightingFragment.glsl" );
     textProgram         = Program::CreateProgram( "assets/shaders/TextVertex.glsl", "assets/shaders/TextFragment.glsl" );
 
+	glGenQueries( 1, &renderTimerQuery );
+
 	glEnable( GL_DEPTH_TEST );
 	glEnable( GL_TEXTURE_2D );
 	glEnable( GL_BLEND );
@@ -58,23 +105,43 @@ void ModelViewer::initialize( int w, int h ) {
 	/****SET SHADER UNIFORMS*****/
 	CPUSkinningProgram->SetUniform( "uModelMatrix", &glm::mat4(1.0)[0][0], 16 );
 	GPUSkinningProgram->SetUniform( "uModelMatrix", &glm::mat4(1.0)[0][0], 16 );
+	GPUAnimationProgram->SetUniform( "uModelMatrix", &glm::mat4(1.0)[0][0], 16 );
+	GPUDualQuaternionProgram->SetUniform( "uModelMatrix", &glm::mat4(1.0)[0][0], 16 );
 	CPUSkinningProgram->SetUniform( "uNormalMatrix", &glm::mat3(1.0)[0][0], 12 );
 	GPUSkinningProgram->SetUniform( "uNormalMatrix", &glm::mat3(1.0)[0][0], 12 );
+	GPUAnimationProgram->SetUniform( "uNormalMatrix", &glm::mat3(1.0)[0][0], 12 );
+	GPUDualQuaternionProgram->SetUniform( "uNormalMatrix", &glm::mat3(1.0)[0][0], 12 );
 	CPUSkinningProgram->SetUniform( "uMatColor", &glm::vec3(1.0, 0.0, 0.0)[0], 3 );
 	GPUSkinningProgram->SetUniform( "uMatColor", &glm::vec3(1.0, 0.0, 0.0)[0], 3 );
+	GPUAnimationProgram->SetUniform( "uMatColor", &glm::vec3(1.0, 0.0, 0.0)[0], 3 );
+	GPUDualQuaternionProgram->SetUniform( "uMatColor", &glm::vec3(1.0, 0.0, 0.0)[0], 3 );
 
 	CPUSkinningProgram->SetUniform( "uLightColor", &glm::vec3( 1.0f, 1.0f, 1.0f )[0], 3 );
 	GPUSkinningProgram->SetUniform( "uLightColor", &glm::vec3( 1.0f, 1.0f, 1.0f )[0], 3 );
+	GPUAnimationProgram->SetUniform( "uLightColor", &glm::vec3( 1.0f, 1.0f, 1.0f )[0], 3 );
+	GPUDualQuaternionProgram->SetUniform( "uLightColor", &glm::vec3( 1.0f, 1.0f, 1.0f )[0], 3 );
 
 	glm::vec3 lightDir = glm::vec3( -20.0f, 0.0f, 0.0f );
 	lightDir = glm::normalize( lightDir );
 	CPUSkinningProgram->SetUniform( "uLightDir", &lightDir[0], 3 );
 	GPUSkinningProgram->SetUniform( "uLightDir", &lightDir[0], 3 );
+	GPUAnimationProgram->SetUniform( "uLightDir", &lightDir[0], 3 );
+	GPUDualQuaternionProgram->SetUniform( "uLightDir", &lightDir[0], 3 );
 
     textProgram->SetUniform( "u_Tint", &glm::vec4( 1.0f, 1.0f, 1.0f, 1.0f )[0], 4 );
     textProgram->SetUniform( "u_TexSampler", 0 );
 
+	jobSystem			= JobSystem::CreateJobSystem();
+	animationScheduler	= AnimationScheduler::CreateAnimationScheduler( VIEWER_ANIMATION_BUDGET );
+	poseCache			= PoseCache::CreatePoseCache( VIEWER_POSE_CACHE_QUANTUM );
+
 	LoadModels();
+	SetPoseCacheEnabled( poseCacheEnabled );
+	SetParallelSkinningEnabled( parallelSkinningEnabled );
+
+	if ( memoryDumpEnabled ) {
+		DumpMemoryReport();
+	}
 }
 /*
 =============
@@ -86,10 +153,22 @@ ModelViewer::shutdown
 void ModelViewer::shutdown( void ) {
 	delete CPUSkinningProgram;	
     delete GPUSkinningProgram;	
+    delete GPUAnimationProgram;
+    delete GPUDualQuaternionProgram;
 	delete textProgram;
 	delete mainCamera;
 	delete consolasFont;
 	delete currentModelText;
+	delete animationScheduler;
+	delete poseCache;
+	delete jobSystem;
+	glDeleteQueries( 1, &renderTimerQuery );
+
+	for ( std::vector<MD5Model*>::iterator instance = crowdModels.begin();
+		  instance != crowdModels.end(); ++instance ) {
+		delete *instance;
+	}
+	crowdModels.clear();
 
 	for ( std::vector<MD5Model*>::iterator model = models.begin();
 		  model != models.end(); ++model ) {
@@ -110,7 +189,7 @@ void ModelViewer::resize( int w, int h ) {
 
 	glViewport( 0, 0, w, h );
 
-	projectionMatrix = glm::perspective( 45.0f, ( float )w / ( float )h, 1.0f, 1000.0f );	
+	projectionMatrix = glm::perspective( VIEWER_FIELD_OF_VIEW, ( float )w / ( float )h, 1.0f, 1000.0f );	
 	orthoMatrix      = glm::ortho( 0.0f, ( float )w, 0.0f, ( float )h, -1.0f, 1.0f );
 
     mainCamera->setPosition( glm::vec3( 0.0f, 50.0f, -200.0f ) );
@@ -119,6 +198,8 @@ void ModelViewer::resize( int w, int h ) {
 
 	CPUSkinningProgram->SetUniform( "uProjectionMatrix", &projectionMatrix[0][0], 16 );
 	GPUSkinningProgram->SetUniform( "uProjectionMatrix", &projectionMatrix[0][0], 16 );
+	GPUAnimationProgram->SetUniform( "uProjectionMatrix", &projectionMatrix[0][0], 16 );
+	GPUDualQuaternionProgram->SetUniform( "uProjectionMatrix", &projectionMatrix[0][0], 16 );
 	textProgram->SetUniform( "u_ProjectionMatrix", &orthoMatrix[0][0], 16 );    
 
 	UpdateCurrentModelInfo();
@@ -134,17 +215,25 @@ void ModelViewer::draw( void ) {
 	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 	
 	if ( currentModel ) {
-        if ( currentModel->GetSkinningType() == CPU_SKINNING ) {
-            CPUSkinningProgram->SetUniform( "uViewMatrix", &mainCamera->getViewMatrix()[0][0], 16 );
-            CPUSkinningProgram->SetUniform( "uNormalMatrix", &glm::mat3(currentModel->GetModelMatrix() * mainCamera->getViewMatrix())[0][0], 12 );
+		//Only one query is in flight, so reading it back never stalls
+		ReadRenderTimer();
+		bool timeRender = !renderTimerPending;
+		if ( timeRender ) {
+			glBeginQuery( GL_TIME_ELAPSED, renderTimerQuery );
+		}
 
-		    currentModel->Render( CPUSkinningProgram );
-        } else if ( currentModel->GetSkinningType() == GPU_SKINNING ) {
-            GPUSkinningProgram->SetUniform( "uViewMatrix", &mainCamera->getViewMatrix()[0][0], 16 );
-            GPUSkinningProgram->SetUniform( "uNormalMatrix", &glm::mat3(currentModel->GetModelMatrix() * mainCamera->getViewMatrix())[0][0], 12 );
+		RenderModel( currentModel );
 
-		    currentModel->Render( GPUSkinningProgram );
-        }
+		if ( timeRender ) {
+			glEndQuery( GL_TIME_ELAPSED );
+			renderTimerPending		= true;
+			renderTimerSkinningType	= currentModel->GetSkinningType();
+		}
+
+		for ( std::vector<MD5Model*>::iterator instance = crowdModels.begin();
+			  instance != crowdModels.end(); ++instance ) {
+			RenderModel( *instance );
+		}
 	}
 
     textProgram->Use();
@@ -153,6 +242,36 @@ void ModelViewer::draw( void ) {
 }
 /*
 =============
+ModelViewer::RenderModel
+
+	Renders a model with the program of its skinning type.
+=============
+*/
+void ModelViewer::RenderModel( MD5Model* model ) {
+    if ( model->GetSkinningType() == CPU_SKINNING ) {
+        CPUSkinningProgram->SetUniform( "uViewMatrix", &mainCamera->getViewMatrix()[0][0], 16 );
+        CPUSkinningProgram->SetUniform( "uNormalMatrix", &glm::mat3(model->GetModelMatrix() * mainCamera->getViewMatrix())[0][0], 12 );
+
+	    model->Render( CPUSkinningProgram );
+    } else if ( model->GetSkinningType() == GPU_SKINNING ) {
+        GPUSkinningProgram->SetUniform( "uViewMatrix", &mainCamera->getViewMatrix()[0][0], 16 );
+        GPUSkinningProgram->SetUniform( "uNormalMatrix", &glm::mat3(model->GetModelMatrix() * mainCamera->getViewMatrix())[0][0], 12 );
+
+	    model->Render( GPUSkinningProgram );
+    } else if ( model->GetSkinningType() == GPU_BAKED_SKINNING ) {
+        GPUAnimationProgram->SetUniform( "uViewMatrix", &mainCamera->getViewMatrix()[0][0], 16 );
+        GPUAnimationProgram->SetUniform( "uNormalMatrix", &glm::mat3(model->GetModelMatrix() * mainCamera->getViewMatrix())[0][0], 12 );
+
+	    model->Render( GPUAnimationProgram );
+    } else if ( model->GetSkinningType() == GPU_DUAL_QUATERNION_SKINNING ) {
+        GPUDualQuaternionProgram->SetUniform( "uViewMatrix", &mainCamera->getViewMatrix()[0][0], 16 );
+        GPUDualQuaternionProgram->SetUniform( "uNormalMatrix", &glm::mat3(model->GetModelMatrix() * mainCamera->getViewMatrix())[0][0], 12 );
+
+	    model->Render( GPUDualQuaternionProgram );
+    }
+}
+/*
+=============
 ModelViewer::update
 
 	ModelViewer update.
@@ -234,32 +353,105 @@ bool ModelViewer::update( float dt ) {
 			UpdateCurrentModelInfo();
 		}
 	} else if ( kb->keyPressed( glsh::KC_K ) ) { //Increase model index
-		++modelIndex;
-		modelIndex = ( ( unsigned )modelIndex >= models.size() ) ? 0 : modelIndex;
-		currentModel = models[modelIndex];
-        currentModel->PlaySingleAnimation( 0 );
-		UpdateCurrentModelInfo();
+		SetCurrentModel( ( ( unsigned )modelIndex + 1 >= models.size() ) ? 0 : modelIndex + 1 );
 	} else if ( kb->keyPressed( glsh::KC_L ) ) { //Decrease model index
-		--modelIndex;
-		modelIndex = ( modelIndex < 0 ) ? models.size() - 1 : modelIndex;
-		currentModel = models[modelIndex];
-        currentModel->PlaySingleAnimation( 0 );
-		UpdateCurrentModelInfo();
+		SetCurrentModel( ( modelIndex - 1 < 0 ) ? models.size() - 1 : modelIndex - 1 );
 	} else if ( kb->keyPressed( glsh::KC_SPACE ) ) { //Toggle animation
 		animateModel = !animateModel;
 	} else if ( kb->keyPressed( glsh::KC_G ) ) { //Change skinning type
-        currentModel->SetSkinningType( ( currentModel->GetSkinningType() == CPU_SKINNING ) ? GPU_SKINNING : CPU_SKINNING );
+        static const ModelSkinningType NextSkinningType[MODEL_SKINNING_TYPE_COUNT] = { GPU_SKINNING, GPU_BAKED_SKINNING, GPU_DUAL_QUATERNION_SKINNING, CPU_SKINNING };
+        currentModel->SetSkinningType( NextSkinningType[currentModel->GetSkinningType()] );
+		for ( std::vector<MD5Model*>::iterator instance = crowdModels.begin();
+			  instance != crowdModels.end(); ++instance ) {
+			( *instance )->SetSkinningType( currentModel->GetSkinningType() );
+		}
         UpdateCurrentModelInfo();
+	} else if ( kb->keyPressed( glsh::KC_V ) ) { //Toggle animation LOD
+		animationLODEnabled = !animationLODEnabled;
+	} else if ( kb->keyPressed( glsh::KC_B ) ) { //Toggle baked skinning palettes
+		currentModel->SetPaletteBakingEnabled( !currentModel->IsPaletteBakingEnabled() );
+		for ( std::vector<MD5Model*>::iterator instance = crowdModels.begin();
+			  instance != crowdModels.end(); ++instance ) {
+			( *instance )->SetPaletteBakingEnabled( currentModel->IsPaletteBakingEnabled() );
+		}
+		UpdateCurrentModelInfo();
+	} else if ( kb->keyPressed( glsh::KC_C ) ) { //Toggle the pose cache
+		SetPoseCacheEnabled( !poseCacheEnabled );
+		UpdateCurrentModelInfo();
+	} else if ( kb->keyPressed( glsh::KC_M ) ) { //Toggle GPU resident mesh data
+		currentModel->SetGPUResident( !currentModel->IsGPUResident() );
+		for ( std::vector<MD5Model*>::iterator instance = crowdModels.begin();
+			  instance != crowdModels.end(); ++instance ) {
+			( *instance )->SetGPUResident( currentModel->IsGPUResident() );
+		}
+		UpdateCurrentModelInfo();
+	} else if ( kb->keyPressed( glsh::KC_N ) ) { //Toggle the memory breakdown
+		memoryReportVisible = !memoryReportVisible;
+		UpdateCurrentModelInfo();
+	} else if ( kb->keyPressed( glsh::KC_X ) ) { //Change CPU skinning mode
+		currentModel->SetCPUSkinningMode( ( CPUSkinningMode )( ( currentModel->GetCPUSkinningMode() + 1 ) % CPU_SKINNING_MODE_COUNT ) );
+		for ( std::vector<MD5Model*>::iterator instance = crowdModels.begin();
+			  instance != crowdModels.end(); ++instance ) {
+			( *instance )->SetCPUSkinningMode( currentModel->GetCPUSkinningMode() );
+		}
+		UpdateCurrentModelInfo();
+	} else if ( kb->keyPressed( glsh::KC_J ) ) { //Toggle parallel CPU skinning
+		SetParallelSkinningEnabled( !parallelSkinningEnabled );
+		UpdateCurrentModelInfo();
+	} else if ( kb->keyPressed( glsh::KC_H ) ) { //Benchmark the skinning types
+		BenchmarkSkinning();
+	} else if ( kb->keyPressed( glsh::KC_F ) ) { //Toggle the crowd
+		SetCrowdEnabled( !crowdEnabled );
+		UpdateCurrentModelInfo();
 	}
 
-	if ( currentModel && animateModel ) {
-		currentModel->Update( dt );
+	UpdateAnimationLOD();
+
+	if ( animateModel ) {
+		poseCache->BeginFrame();
+
+		float tanHalfFieldOfView = tanf( glm::radians( VIEWER_FIELD_OF_VIEW ) * 0.5f );
+		animationScheduler->Update( dt, mainCamera->getPosition(), tanHalfFieldOfView, jobSystem );
+
+		infoRefreshTimer += dt;
+		if ( infoRefreshTimer >= VIEWER_INFO_REFRESH_INTERVAL ) {
+			infoRefreshTimer = 0.0f;
+			UpdateCurrentModelInfo();
+		}
 	}
 
 	return true; // request to keep going
 }
 /*
 =============
+ModelViewer::UpdateAnimationLOD
+
+	Picks each active model's animation LOD from its projected size.
+=============
+*/
+void ModelViewer::UpdateAnimationLOD( void ) {
+	if ( currentModel == NULL ) {
+		return;
+	}
+
+	AnimationLODLevel	oldLevel			= currentModel->GetAnimationLOD();
+	float				tanHalfFieldOfView	= tanf( glm::radians( VIEWER_FIELD_OF_VIEW ) * 0.5f );
+
+	for ( unsigned i = 0; i <= crowdModels.size(); ++i ) {
+		MD5Model* model = ( i == 0 ) ? currentModel : crowdModels[i - 1];
+		if ( animationLODEnabled ) {
+			model->SelectAnimationLOD( model->ComputeScreenSize( mainCamera->getPosition(), tanHalfFieldOfView ) );
+		} else {
+			model->SetAnimationLOD( ANIMATION_LOD_FULL );
+		}
+	}
+
+	if ( currentModel->GetAnimationLOD() != oldLevel ) {
+		UpdateCurrentModelInfo();
+	}
+}
+/*
+=============
 ModelViewer::LoadModels
 
 	Load the models stated in the assets folder.
@@ -291,7 +483,188 @@ void ModelViewer::LoadModels( void ) {
 	}
 
 	if ( models.size() > 0 ) {
-		currentModel = models[0];
+		SetCurrentModel( 0 );
+	}
+}
+/*
+=============
+ModelViewer::SetPoseCacheEnabled
+
+	Shares evaluated poses between the models through the pose cache.
+=============
+*/
+void ModelViewer::SetPoseCacheEnabled( bool enabled ) {
+	poseCacheEnabled = enabled;
+
+	for ( std::vector<MD5Model*>::iterator model = models.begin();
+		  model != models.end(); ++model ) {
+		( *model )->SetPoseCache( poseCacheEnabled ? poseCache : NULL );
+	}
+	for ( std::vector<MD5Model*>::iterator instance = crowdModels.begin();
+		  instance != crowdModels.end(); ++instance ) {
+		( *instance )->SetPoseCache( poseCacheEnabled ? poseCache : NULL );
+	}
+}
+/*
+=============
+ModelViewer::SetParallelSkinningEnabled
+
+	Splits every model's CPU skinning into vertex chunks on the job system.
+=============
+*/
+void ModelViewer::SetParallelSkinningEnabled( bool enabled ) {
+	parallelSkinningEnabled = enabled;
+
+	for ( std::vector<MD5Model*>::iterator model = models.begin();
+		  model != models.end(); ++model ) {
+		( *model )->SetSkinningJobSystem( parallelSkinningEnabled ? jobSystem : NULL );
+	}
+	for ( std::vector<MD5Model*>::iterator instance = crowdModels.begin();
+		  instance != crowdModels.end(); ++instance ) {
+		( *instance )->SetSkinningJobSystem( parallelSkinningEnabled ? jobSystem : NULL );
+	}
+}
+/*
+=============
+ModelViewer::ReadRenderTimer
+
+	Stores the GPU time of the last timed draw once it's available.
+=============
+*/
+void ModelViewer::ReadRenderTimer( void ) {
+	if ( !renderTimerPending ) {
+		return;
+	}
+
+	GLint available = 0;
+	glGetQueryObjectiv( renderTimerQuery, GL_QUERY_RESULT_AVAILABLE, &available );
+	if ( available ) {
+		GLuint64 elapsedNanoseconds = 0;
+		glGetQueryObjectui64v( renderTimerQuery, GL_QUERY_RESULT, &elapsedNanoseconds );
+		renderMilliseconds[renderTimerSkinningType] = ( float )( elapsedNanoseconds / 1000000.0 );
+		renderTimerPending = false;
+	}
+}
+/*
+=============
+ModelViewer::BenchmarkSkinning
+
+	Prints the time of every CPU skinning mode on the current pose,
+	then the palette uploaded per frame and the latest GPU draw
+	time of every skinning type. A GPU time is only there once
+	the model has been drawn with that type.
+=============
+*/
+void ModelViewer::BenchmarkSkinning( void ) {
+	if ( currentModel == NULL ) {
+		return;
+	}
+
+	printf( "Skinning benchmark: %s, %u active joints, %s\n", currentModel->GetModelName().c_str(), currentModel->GetActiveJointCount(),
+			( parallelSkinningEnabled ? std::to_string( jobSystem->GetThreadCount() ) + " threads" : std::string( "1 thread" ) ).c_str() );
+
+	printf( "   %-24s %12s\n", "CPU Skinning Mode", "ms per skin" );
+	for ( unsigned mode = 0; mode < CPU_SKINNING_MODE_COUNT; ++mode ) {
+		float milliseconds = 0.0f;
+		if ( currentModel->BenchmarkCPUSkinning( ( CPUSkinningMode )mode, VIEWER_BENCHMARK_ITERATIONS, milliseconds ) ) {
+			printf( "   %-24s %12.4f\n", CPUSkinningModeNames[mode], milliseconds );
+		} else {
+			printf( "   %-24s %12s\n", CPUSkinningModeNames[mode], "No CPU data" );
+		}
+	}
+
+	static const unsigned PaletteFloats[MODEL_SKINNING_TYPE_COUNT] = { 0, PALETTE_MATRIX_FLOATS, 0, DUAL_QUATERNION_FLOATS };
+	printf( "   %-24s %12s %12s\n", "Skinning Type", "Palette bytes", "GPU ms" );
+	for ( unsigned type = 0; type < MODEL_SKINNING_TYPE_COUNT; ++type ) {
+		printf( "   %-24s %12u %12.4f\n", SkinningTypeNames[type], ( unsigned )( currentModel->GetActiveJointCount() * PaletteFloats[type] * sizeof( float ) ), renderMilliseconds[type] );
+	}
+}
+/*
+=============
+ModelViewer::DumpMemoryReport
+
+	Prints the memory used by every loaded model.
+=============
+*/
+void ModelViewer::DumpMemoryReport( void ) const {
+	MemoryUsage total;
+
+	printf( "Memory report\n" );
+	printf( "   %-8s %-40s %12s %12s\n", "Type", "Name", "CPU bytes", "GPU bytes" );
+	for ( std::vector<MD5Model*>::const_iterator model = models.begin();
+		  model != models.end(); ++model ) {
+		MemoryReport report;
+		( *model )->BuildMemoryReport( report );
+
+		for ( MemoryReport::const_iterator entry = report.begin();
+			  entry != report.end(); ++entry ) {
+			printf( "   %-8s %-40s %12u %12u\n", entry->category.c_str(), entry->name.c_str(), ( unsigned )entry->usage.cpuBytes, ( unsigned )entry->usage.gpuBytes );
+			total += entry->usage;
+		}
+	}
+	printf( "   %-8s %-40s %12u %12u\n", "Total", "", ( unsigned )total.cpuBytes, ( unsigned )total.gpuBytes );
+}
+/*
+=============
+ModelViewer::SetCurrentModel
+
+	Switches the displayed model and hands it to the animation scheduler.
+	The crowd is rebuilt from the new model.
+=============
+*/
+void ModelViewer::SetCurrentModel( int index ) {
+	if ( currentModel ) {
+		animationScheduler->RemoveModel( currentModel );
+	}
+
+	modelIndex		= index;
+	currentModel	= models[modelIndex];
+	currentModel->PlaySingleAnimation( 0 );
+	animationScheduler->AddModel( currentModel );
+	SetCrowdEnabled( crowdEnabled );
+
+	UpdateCurrentModelInfo();
+}
+/*
+=============
+ModelViewer::SetCrowdEnabled
+
+	Fills rows behind the current model with instances of it,
+	all handed to the animation scheduler. The instances are
+	started at a few playback phases so the scheduler has to
+	time slice them and instances in the same phase share
+	poses through the pose cache.
+=============
+*/
+void ModelViewer::SetCrowdEnabled( bool enabled ) {
+	for ( std::vector<MD5Model*>::iterator instance = crowdModels.begin();
+		  instance != crowdModels.end(); ++instance ) {
+		animationScheduler->RemoveModel( *instance );
+		delete *instance;
+	}
+	crowdModels.clear();
+
+	crowdEnabled = enabled;
+	if ( !crowdEnabled || currentModel == NULL ) {
+		return;
+	}
+
+	for ( unsigned i = 0; i + 1 < VIEWER_CROWD_SIZE; ++i ) {
+		MD5Model* instance = MD5Model::CreateMD5ModelInstance( currentModel );
+		if ( instance == NULL ) {
+			printf( "Crowd stopped at %u instances of '%s'\n", ( unsigned )crowdModels.size(), currentModel->GetModelName().c_str() );
+			break;
+		}
+
+		float column	= ( float )( i % VIEWER_CROWD_COLUMNS ) - ( VIEWER_CROWD_COLUMNS - 1 ) * 0.5f;
+		float row		= ( float )( i / VIEWER_CROWD_COLUMNS + 1 );
+		instance->SetPosition( glm::vec3( currentModel->GetModelMatrix()[3] ) + glm::vec3( column, 0.0f, row ) * VIEWER_CROWD_SPACING );
+		instance->Update( ( i % VIEWER_CROWD_PHASES ) * VIEWER_CROWD_PHASE_STEP );
+		instance->SetPoseCache( poseCacheEnabled ? poseCache : NULL );
+		instance->SetSkinningJobSystem( parallelSkinningEnabled ? jobSystem : NULL );
+
+		animationScheduler->AddModel( instance );
+		crowdModels.push_back( instance );
 	}
 }
 /*
@@ -310,11 +683,64 @@ void ModelViewer::UpdateCurrentModelInfo( void ) {
 		modelInfo += "Current First Animation: " + animNames[0] + "\n";
 		modelInfo += "Current Second Animation: " + animNames[1] + "\n";
 		modelInfo += "Current Blend Amount: " + std::to_string( currentModel->GetBlendFactor() ) + "\n"; 
+		modelInfo += "Active Joints: " + std::to_string( currentModel->GetActiveJointCount() ) + " / " + std::to_string( currentModel->GetJointCount() ) + "\n";
+
+		static const char* LODNames[ANIMATION_LOD_COUNT] = { "Full", "Reduced", "Minimal", "Frozen" };
+		modelInfo += "Animation LOD: " + std::string( LODNames[currentModel->GetAnimationLOD()] ) + " (" + std::to_string( currentModel->GetLODJointCount() ) + " joints)\n";
+
+		const AnimationSchedulerStats& schedulerStats = animationScheduler->GetStats();
+		modelInfo += "Animation Updates: " + std::to_string( schedulerStats.updatedCount ) + " updated, " + std::to_string( schedulerStats.skippedCount ) + " skipped (" + 
+					 std::to_string( schedulerStats.spentMilliseconds ) + " / " + std::to_string( schedulerStats.budgetMilliseconds ) + " ms)\n";
+		modelInfo += "Crowd: " + ( crowdEnabled ? std::to_string( crowdModels.size() + 1 ) + " models" : std::string( "Disabled" ) ) + "\n";
+
+		if ( poseCacheEnabled ) {
+			const PoseCacheStats& cacheStats = poseCache->GetStats();
+			modelInfo += "Pose Cache: " + std::to_string( cacheStats.hits ) + " hits, " + std::to_string( cacheStats.misses ) + " misses (" + 
+						 std::to_string( ( int )( cacheStats.HitRate() * 100.0f ) ) + "%)\n";
+		} else {
+			modelInfo += "Pose Cache: Disabled\n";
+		}
+
+		if ( currentModel->IsPaletteBakingEnabled() ) {
+			modelInfo += "Baked Palettes: " + std::string( currentModel->IsUsingBakedPalette() ? "In Use" : "Unused" ) + " (" + 
+						 std::to_string( currentModel->GetBakedPaletteMemory() / 1024 ) + " KB)\n";
+		} else {
+			modelInfo += "Baked Palettes: Disabled\n";
+		}
+
+		modelInfo += "Mesh Data: " + std::string( currentModel->IsGPUResident() ? "GPU Resident" : "Resident" ) + " (" + 
+					 std::to_string( currentModel->GetMeshMemory() / 1024 ) + " KB CPU)\n";
+
+		MemoryUsage memoryUsage = currentModel->GetMemoryUsage();
+		modelInfo += "Memory: " + std::to_string( memoryUsage.cpuBytes / 1024 ) + " KB CPU, " + std::to_string( memoryUsage.gpuBytes / 1024 ) + " KB GPU\n";
+		if ( memoryReportVisible ) {
+			MemoryReport report;
+			currentModel->BuildMemoryReport( report );
+			for ( MemoryReport::const_iterator entry = report.begin();
+				  entry != report.end(); ++entry ) {
+				modelInfo += "   " + entry->category + " " + entry->name + ": " + std::to_string( entry->usage.cpuBytes / 1024 ) + " KB CPU, " + 
+							 std::to_string( entry->usage.gpuBytes / 1024 ) + " KB GPU\n";
+			}
+		}
+
+		modelInfo += "Render Time: " + std::to_string( renderMilliseconds[currentModel->GetSkinningType()] ) + " ms GPU\n";
 
         if ( currentModel->GetSkinningType() == CPU_SKINNING ) {
-            modelInfo += "CPU Skinning Enabled";
+			if ( currentModel->GetCPUSkinningMode() == CPU_SKINNING_PALETTE ) {
+				float maxError		= 0.0f;
+				float averageError	= 0.0f;
+				if ( currentModel->MeasurePaletteError( maxError, averageError ) ) {
+					modelInfo += "Palette Error: " + std::to_string( maxError ) + " max, " + std::to_string( averageError ) + " average\n";
+				}
+			}
+            modelInfo += std::string( "CPU Skinning Enabled (" ) + SkinningKernel::GetName() + ", " + CPUSkinningModeNames[currentModel->GetCPUSkinningMode()] + ", " + 
+						 ( parallelSkinningEnabled ? std::to_string( jobSystem->GetThreadCount() ) + " threads)" : std::string( "1 thread)" ) );
         } else if ( currentModel->GetSkinningType() == GPU_SKINNING ) {
             modelInfo += "GPU Skinning Enabled";
+        } else if ( currentModel->GetSkinningType() == GPU_BAKED_SKINNING ) {
+            modelInfo += "GPU Animation Texture Enabled (" + std::to_string( currentModel->GetAnimationTextureMemory() / 1024 ) + " KB)";
+        } else if ( currentModel->GetSkinningType() == GPU_DUAL_QUATERNION_SKINNING ) {
+            modelInfo += "GPU Dual Quaternion Skinning Enabled";
         }
 
 		currentModelText->SetText( consolasFont, modelInfo );
@@ -4,6 +4,7 @@
 #include "GLSH.h"
 #include "Program.h"
 #include "MD5Model.h"
+#include "AnimationScheduler.h"
 
 /*
 =============================
@@ -26,12 +27,25 @@ public:
 	void                    draw( void )                override;
 	bool                    update( float dt )			override;
 
+	inline void				SetMemoryDumpEnabled( bool enabled ) { memoryDumpEnabled = enabled; }
+
 private:
     void                    LoadModels( void );
 	void					UpdateCurrentModelInfo( void );
+	void					UpdateAnimationLOD( void );
+	void					SetCurrentModel( int index );
+	void					SetCrowdEnabled( bool enabled );
+	void					RenderModel( MD5Model* model );
+	void					SetPoseCacheEnabled( bool enabled );
+	void					SetParallelSkinningEnabled( bool enabled );
+	void					ReadRenderTimer( void );
+	void					BenchmarkSkinning( void );
+	void					DumpMemoryReport( void ) const;
 	
 	bool					animateModel;
+	bool					animationLODEnabled;
     int                     modelIndex;
+	float					infoRefreshTimer;
 
 	float					screenWidth;
 	float					screenHeight;
@@ -40,6 +54,8 @@ private:
 	
     Program*				CPUSkinningProgram;
     Program*				GPUSkinningProgram;
+    Program*				GPUAnimationProgram;
+    Program*				GPUDualQuaternionProgram;
     Program*				textProgram;
 	
     glm::mat4				projectionMatrix;
@@ -47,6 +63,21 @@ private:
 
 	std::vector<MD5Model*>	models;
 	MD5Model*				currentModel;
+	std::vector<MD5Model*>	crowdModels;		//Instances of currentModel drawn around it
+	bool					crowdEnabled;
+
+	JobSystem*				jobSystem;
+	AnimationScheduler*		animationScheduler;
+	PoseCache*				poseCache;
+	bool					poseCacheEnabled;
+	bool					parallelSkinningEnabled;	//CPU skinning split across the job system
+	bool					memoryDumpEnabled;		//Print every model's memory once loaded
+	bool					memoryReportVisible;	//Break the current model's memory down in the info text
+
+	GLuint					renderTimerQuery;			//GPU time of the current model's draw calls
+	bool					renderTimerPending;			//renderTimerQuery's result hasn't been read yet
+	ModelSkinningType		renderTimerSkinningType;	//Skinning type renderTimerQuery timed
+	float					renderMilliseconds[MODEL_SKINNING_TYPE_COUNT];	//Latest GPU time of each skinning type
 
     glsh::TextBatch*        currentModelText;
     glsh::Font*             consolasFont;
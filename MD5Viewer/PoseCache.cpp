@@ -0,0 +1,256 @@
+#include "PoseCache.h"
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+//Blend weights are matched to this many steps
+#define POSE_CACHE_WEIGHT_STEPS		1024.0f
+//Time quantum used when none is set, instances only share exact phases
+#define POSE_CACHE_MIN_QUANTUM		0.001f
+/*
+=============
+PoseCacheKey::operator<
+
+	Orders keys by content.
+=============
+*/
+bool PoseCacheKey::operator<( const PoseCacheKey& other ) const {
+	if ( joints->size() != other.joints->size() ) {
+		return joints->size() < other.joints->size();
+	}
+	if ( lod != other.lod ) {
+		return lod < other.lod;
+	}
+	if ( layers.size() != other.layers.size() ) {
+		return layers.size() < other.layers.size();
+	}
+	if ( skeleton != other.skeleton ) {
+		int compare = skeleton->compare( *other.skeleton );
+		if ( compare != 0 ) {
+			return compare < 0;
+		}
+	}
+
+	for ( unsigned i = 0; i < layers.size(); ++i ) {
+		const PoseCacheLayerKey& layer		= layers[i];
+		const PoseCacheLayerKey& otherLayer	= other.layers[i];
+
+		if ( layer.timeStep != otherLayer.timeStep ) {
+			return layer.timeStep < otherLayer.timeStep;
+		}
+		if ( layer.weightStep != otherLayer.weightStep ) {
+			return layer.weightStep < otherLayer.weightStep;
+		}
+		if ( layer.additive != otherLayer.additive ) {
+			return otherLayer.additive;
+		}
+		if ( layer.clip != otherLayer.clip ) {
+			int compare = layer.clip->compare( *otherLayer.clip );
+			if ( compare != 0 ) {
+				return compare < 0;
+			}
+		}
+		if ( layer.mask != otherLayer.mask ) {
+			if ( layer.mask == NULL || otherLayer.mask == NULL ) {
+				return layer.mask == NULL;
+			}
+			if ( *layer.mask != *otherLayer.mask ) {
+				return *layer.mask < *otherLayer.mask;
+			}
+		}
+	}
+
+	if ( joints != other.joints && *joints != *other.joints ) {
+		return *joints < *other.joints;
+	}
+
+	return false;
+}
+/*
+=============
+PoseCache::PoseCache
+
+	PoseCache Constructor.
+=============
+*/
+PoseCache::PoseCache( void ) :
+	usedEntries( 0 ),
+	timeQuantum( 0.0f ),
+	frame( 1 )
+{}
+/*
+=============
+PoseCache::~PoseCache
+
+	PoseCache Destructor.
+=============
+*/
+PoseCache::~PoseCache( void ) {
+	for ( std::vector<PoseCacheEntry*>::iterator entry = entries.begin();
+		  entry != entries.end(); ++entry ) {
+		glDeleteTextures( 1, &( *entry )->paletteTextureName );
+		glDeleteBuffers( 1, &( *entry )->paletteBufferName );
+		delete *entry;
+	}
+	entries.clear();
+}
+/*
+=============
+PoseCache::CreatePoseCache
+
+	Creates a pose cache that matches playback
+	times to the nearest timeQuantum seconds.
+=============
+*/
+PoseCache* PoseCache::CreatePoseCache( float timeQuantum ) {
+	PoseCache* cache = new PoseCache();
+
+	if ( cache == NULL ) {
+		return NULL;
+	}
+
+	cache->SetTimeQuantum( timeQuantum );
+	return cache;
+}
+/*
+=============
+PoseCache::BeginFrame
+
+	Drops last frame's poses.
+	Call before any model is updated.
+=============
+*/
+void PoseCache::BeginFrame( void ) {
+	std::lock_guard<std::mutex> guard( lock );
+
+	lookup.clear();
+	usedEntries = 0;
+	stats		= PoseCacheStats();
+	++frame;
+}
+/*
+=============
+PoseCache::BuildKey
+
+	Builds the key for a set of blend inputs, and the inputs
+	with their times and weights snapped to the key, so every
+	instance sharing the key evaluates the same pose.
+=============
+*/
+void PoseCache::BuildKey( const std::string& skeleton, const JointIndicies& joints, AnimationLODLevel lod,
+						  const AnimationBlendInputs& inputs, PoseCacheKey& key, AnimationBlendInputs& quantizedInputs ) const {
+	key.skeleton	= &skeleton;
+	key.joints		= &joints;
+	key.lod			= lod;
+	key.layers.clear();
+	quantizedInputs.clear();
+
+	float quantum = std::max( timeQuantum, POSE_CACHE_MIN_QUANTUM );
+
+	for ( AnimationBlendInputs::const_iterator input = inputs.begin(); input != inputs.end(); ++input ) {
+		if ( input->clip == NULL ) {
+			continue;
+		}
+
+		PoseCacheLayerKey layer;
+		layer.clip			= &input->clip->GetSourcePath();
+		layer.mask			= input->mask;
+		layer.additive		= input->additive;
+		layer.weightStep	= ( int )floorf( input->weight * POSE_CACHE_WEIGHT_STEPS + 0.5f );
+		layer.timeStep		= ( int )floorf( input->time / quantum + 0.5f );
+		key.layers.push_back( layer );
+
+		AnimationBlendInput quantized = *input;
+		quantized.weight	= layer.weightStep / POSE_CACHE_WEIGHT_STEPS;
+		quantized.time		= input->clip->WrapTime( layer.timeStep * quantum );
+		quantizedInputs.push_back( quantized );
+	}
+}
+/*
+=============
+PoseCache::FindOrEvaluate
+
+	Returns the entry for key.
+	The first caller evaluates the pose, later callers
+	wait for it to finish instead of evaluating again.
+	The entry keeps a copy of the key's joint set, so
+	the stored key doesn't depend on the first caller.
+=============
+*/
+PoseCacheEntry* PoseCache::FindOrEvaluate( const PoseCacheKey& key, const PoseEvaluator& evaluate ) {
+	std::unique_lock<std::mutex> cacheGuard( lock );
+
+	std::map<PoseCacheKey, PoseCacheEntry*>::iterator found = lookup.find( key );
+	if ( found != lookup.end() ) {
+		PoseCacheEntry* entry = found->second;
+		++stats.hits;
+		cacheGuard.unlock();
+
+		std::lock_guard<std::mutex> entryGuard( entry->lock ); //Wait for the evaluation
+		return entry;
+	}
+
+	if ( usedEntries == entries.size() ) {
+		entries.push_back( new PoseCacheEntry() );
+	}
+	PoseCacheEntry* entry	= entries[usedEntries++];
+	entry->paletteJoints	= *key.joints;
+
+	PoseCacheKey storedKey	= key;
+	storedKey.joints		= &entry->paletteJoints;
+	lookup.insert( std::make_pair( storedKey, entry ) );
+	++stats.misses;
+
+	std::lock_guard<std::mutex> entryGuard( entry->lock );
+	cacheGuard.unlock();
+
+	evaluate( entry->pose );
+	return entry;
+}
+/*
+=============
+PoseCache::BindPalette
+
+	Binds the entry's matrix palette, packed 3x4 like the
+	model's own in the order of the entry's joint set,
+	uploading it if this is the first use this frame.
+	Returns false if the entry is from an older frame.
+=============
+*/
+bool PoseCache::BindPalette( PoseCacheEntry* entry, unsigned entryFrame, const std::vector<glm::mat4>& inverseBoneMatricies ) {
+	if ( entry == NULL || entryFrame != frame ) {
+		return false;
+	}
+
+	if ( entry->paletteBufferName == 0 ) {
+		glGenBuffers( 1, &entry->paletteBufferName );
+		glGenTextures( 1, &entry->paletteTextureName );
+		if ( entry->paletteBufferName == 0 || entry->paletteTextureName == 0 ) {
+			printf( "Pose cache palette could not be created\n" );
+			return false;
+		}
+	}
+
+	if ( entry->paletteFrame != frame ) {
+		const JointIndicies& paletteJoints = entry->paletteJoints;
+
+		std::vector<float> palette( paletteJoints.size() * PALETTE_MATRIX_FLOATS );
+		for ( unsigned paletteIndex = 0; paletteIndex < paletteJoints.size(); ++paletteIndex ) {
+			unsigned jointIndex = paletteJoints[paletteIndex];
+			PackPaletteMatrix( entry->pose.jointMatricies[jointIndex] * inverseBoneMatricies[jointIndex], &palette[paletteIndex * PALETTE_MATRIX_FLOATS] );
+		}
+
+		glBindBuffer( GL_TEXTURE_BUFFER, entry->paletteBufferName );
+		glBufferData( GL_TEXTURE_BUFFER, sizeof( float ) * palette.size(), &palette[0], GL_DYNAMIC_DRAW );
+
+		entry->paletteFrame = frame;
+		++stats.paletteUploads;
+	} else {
+		++stats.paletteShares;
+	}
+
+	glActiveTexture( GL_TEXTURE1 );
+	glBindTexture( GL_TEXTURE_2D, entry->paletteTextureName );
+	glTexBuffer( GL_TEXTURE_BUFFER, GL_RGBA32F, entry->paletteBufferName );
+	return true;
+}
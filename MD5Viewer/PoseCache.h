@@ -0,0 +1,144 @@
+#ifndef __POSECACHE_H__
+#define __POSECACHE_H__
+
+#include <map>
+#include <mutex>
+#include <functional>
+#include <GL\glew.h>
+#include "MD5ModelStructs.h"
+#include "MD5Animation.h"
+
+/*
+========================
+
+	PoseCacheLayerKey
+
+		The quantized playback state of one blend input.
+
+========================
+*/
+struct PoseCacheLayerKey {
+	const std::string*	clip;		//Source path of the clip
+	const BoneMask*		mask;
+	int					timeStep;
+	int					weightStep;
+	bool				additive;
+};
+typedef std::vector<PoseCacheLayerKey> PoseCacheLayerKeys;
+/*
+========================
+
+	PoseCacheKey
+
+		Everything an evaluated pose depends on.
+		Strings, joint sets and masks are compared by
+		content, so different models loaded from the
+		same files with the same requested joints
+		share entries.
+
+========================
+*/
+struct PoseCacheKey {
+	const std::string*	skeleton;	//Source path of the mesh
+	const JointIndicies* joints;	//Active joints of the model, in palette order
+	AnimationLODLevel	lod;
+	PoseCacheLayerKeys	layers;
+
+	bool				operator<( const PoseCacheKey& other ) const;
+};
+/*
+========================
+
+	PoseCacheEntry
+
+		A pose shared by every instance with the same key,
+		and the matrix palette uploaded for it.
+
+========================
+*/
+struct PoseCacheEntry {
+	std::mutex			lock;			//Held while the pose is evaluated
+	Skeleton			pose;
+	JointIndicies		paletteJoints;	//The key's joint set, the palette is packed in this order
+	unsigned			paletteFrame;	//Frame the palette was last uploaded in
+	GLuint				paletteBufferName;
+	GLuint				paletteTextureName;
+
+	PoseCacheEntry( void ) :
+		paletteFrame( 0 ),
+		paletteBufferName( 0 ),
+		paletteTextureName( 0 )
+	{}
+};
+/*
+========================
+
+	PoseCacheStats
+
+		Cache use during the current frame.
+
+========================
+*/
+struct PoseCacheStats {
+	unsigned	hits;
+	unsigned	misses;
+	unsigned	paletteUploads;
+	unsigned	paletteShares;
+
+	PoseCacheStats( void ) :
+		hits( 0 ),
+		misses( 0 ),
+		paletteUploads( 0 ),
+		paletteShares( 0 )
+	{}
+
+	inline float HitRate( void ) const { return ( hits + misses > 0 ) ? ( float )hits / ( float )( hits + misses ) : 0.0f; }
+};
+/*
+========================
+
+	PoseCache
+
+		A per-frame cache of evaluated poses.
+		Playback times are quantized to the time quantum
+		so instances at nearly the same phase share one
+		evaluation and one uploaded matrix palette.
+		Entries are safe to look up from job threads,
+		palettes must be bound on the render thread.
+
+========================
+*/
+class PoseCache {
+public:
+	typedef std::function<void( Skeleton& )>	PoseEvaluator;
+
+										~PoseCache( void );
+
+	static PoseCache*					CreatePoseCache( float timeQuantum );
+
+	void								BeginFrame( void );
+
+	void								BuildKey( const std::string& skeleton, const JointIndicies& joints, AnimationLODLevel lod,
+												  const AnimationBlendInputs& inputs, PoseCacheKey& key, AnimationBlendInputs& quantizedInputs ) const;
+	PoseCacheEntry*						FindOrEvaluate( const PoseCacheKey& key, const PoseEvaluator& evaluate );
+	bool								BindPalette( PoseCacheEntry* entry, unsigned entryFrame, const std::vector<glm::mat4>& inverseBoneMatricies );
+
+	inline void							SetTimeQuantum( float seconds ) { timeQuantum = seconds; }
+	inline float						GetTimeQuantum( void ) const { return timeQuantum; }
+	inline unsigned						GetFrame( void ) const { return frame; }
+	inline const PoseCacheStats&		GetStats( void ) const { return stats; }
+
+private:
+										PoseCache( void );
+
+	std::mutex							lock;
+	std::map<PoseCacheKey, PoseCacheEntry*> lookup;
+	std::vector<PoseCacheEntry*>		entries;		//Reused every frame
+	unsigned							usedEntries;
+
+	float								timeQuantum;
+	unsigned							frame;
+	PoseCacheStats						stats;
+};
+
+#endif //__POSECACHE_H__
@@ -0,0 +1,506 @@
+#include "SkinningKernel.h"
+#include <cstring>
+#include <algorithm>
+
+#if defined( SKINNING_KERNEL_AVX2 )
+	#include <immintrin.h>
+#elif defined( SKINNING_KERNEL_SSE )
+	#include <emmintrin.h>
+#endif
+
+//The vertex kernels are templated on the number of weights per vertex.
+//A fixed count unrolls the weight loop, ANY_WEIGHT_COUNT reads it from the vertex.
+#define ANY_WEIGHT_COUNT	0
+/*
+=============
+SkinVertexScalar
+
+	Skins one vertex one weight at a time.
+=============
+*/
+template<unsigned WeightCount>
+static inline void SkinVertexScalar( const SkinningStreams& streams, const glm::mat4* jointMatricies, unsigned vertexIndex, float* destination ) {
+	const VertexWeightRange&	weightRange		= streams.weightRanges[vertexIndex];
+	const glm::vec3&			jointNormal		= streams.jointNormals[vertexIndex];
+	const unsigned				countWeight		= ( WeightCount != ANY_WEIGHT_COUNT ) ? WeightCount : weightRange.countWeight;
+	glm::vec3					vertexPosition	= glm::vec3( 0.0f );
+	glm::vec3					vertexNormal	= glm::vec3( 0.0f );
+
+	for ( unsigned i = 0; i < countWeight; ++i ) {
+		const unsigned		weight		= weightRange.startWeight + i;
+		const glm::mat4&	matrix		= jointMatricies[streams.weightJoints[weight]];
+		const glm::vec4&	position	= streams.weightPositions[weight];
+
+		vertexPosition	+= ( glm::vec3( matrix[0] ) * position.x + glm::vec3( matrix[1] ) * position.y + glm::vec3( matrix[2] ) * position.z + glm::vec3( matrix[3] ) ) * position.w;
+		vertexNormal	+= ( glm::vec3( matrix[0] ) * jointNormal.x + glm::vec3( matrix[1] ) * jointNormal.y + glm::vec3( matrix[2] ) * jointNormal.z ) * position.w;
+	}
+
+	memcpy( &destination[0], &vertexPosition[0], sizeof( float ) * 3 ); //Vertex Position
+	memcpy( &destination[3], &vertexNormal[0]  , sizeof( float ) * 3 ); //Vertex Normal
+}
+
+#if defined( SKINNING_KERNEL_AVX2 ) || defined( SKINNING_KERNEL_SSE )
+/*
+=============
+StoreSkinnedVertex
+
+	Writes the xyz of a position and normal as 6 packed floats.
+	Goes through the stack so nothing past the vertex is touched,
+	neighbouring vertex ranges may be written by other threads.
+=============
+*/
+static inline void StoreSkinnedVertex( __m128 position, __m128 normal, float* destination ) {
+	float values[8];
+	_mm_storeu_ps( &values[0], position );
+	_mm_storeu_ps( &values[4], normal );
+	memcpy( &destination[0], &values[0], sizeof( float ) * 3 ); //Vertex Position
+	memcpy( &destination[3], &values[4], sizeof( float ) * 3 ); //Vertex Normal
+}
+/*
+=============
+AccumulateWeight
+
+	Adds one weight's position and normal to the vertex.
+	The joint matrix is held as four column registers so
+	a weight is a handful of multiply adds.
+=============
+*/
+static inline void AccumulateWeight( const float* matrixFloats, const SkinningStreams& streams, unsigned weight,
+									 const __m128& normalX, const __m128& normalY, const __m128& normalZ, __m128& vertexPosition, __m128& vertexNormal ) {
+	const float* matrix = &matrixFloats[streams.weightJoints[weight] * 16];
+
+	__m128 column0 = _mm_loadu_ps( &matrix[0] );
+	__m128 column1 = _mm_loadu_ps( &matrix[4] );
+	__m128 column2 = _mm_loadu_ps( &matrix[8] );
+	__m128 column3 = _mm_loadu_ps( &matrix[12] );
+
+	__m128 weightPosition	= _mm_loadu_ps( &streams.weightPositions[weight].x );
+	__m128 bias				= _mm_shuffle_ps( weightPosition, weightPosition, _MM_SHUFFLE( 3, 3, 3, 3 ) );
+	__m128 positionX		= _mm_shuffle_ps( weightPosition, weightPosition, _MM_SHUFFLE( 0, 0, 0, 0 ) );
+	__m128 positionY		= _mm_shuffle_ps( weightPosition, weightPosition, _MM_SHUFFLE( 1, 1, 1, 1 ) );
+	__m128 positionZ		= _mm_shuffle_ps( weightPosition, weightPosition, _MM_SHUFFLE( 2, 2, 2, 2 ) );
+
+	__m128 position = _mm_add_ps( _mm_add_ps( _mm_mul_ps( column0, positionX ), _mm_mul_ps( column1, positionY ) ),
+								  _mm_add_ps( _mm_mul_ps( column2, positionZ ), column3 ) );
+	__m128 normal	= _mm_add_ps( _mm_add_ps( _mm_mul_ps( column0, normalX ), _mm_mul_ps( column1, normalY ) ),
+								  _mm_mul_ps( column2, normalZ ) );
+
+	vertexPosition	= _mm_add_ps( vertexPosition, _mm_mul_ps( position, bias ) );
+	vertexNormal	= _mm_add_ps( vertexNormal, _mm_mul_ps( normal, bias ) );
+}
+
+#if defined( SKINNING_KERNEL_AVX2 )
+/*
+=============
+AccumulateWeightPair
+
+	Adds two neighbouring weights to the vertex, one in each
+	half of the registers. The halves are summed per vertex.
+=============
+*/
+static inline void AccumulateWeightPair( const float* matrixFloats, const SkinningStreams& streams, unsigned weight,
+										 const __m256& normalX, const __m256& normalY, const __m256& normalZ, __m256& positionPair, __m256& normalPair ) {
+	const float* matrixA = &matrixFloats[streams.weightJoints[weight] * 16];
+	const float* matrixB = &matrixFloats[streams.weightJoints[weight + 1] * 16];
+
+	__m256 column0 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( &matrixA[0] ) ) , _mm_loadu_ps( &matrixB[0] ) , 1 );
+	__m256 column1 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( &matrixA[4] ) ) , _mm_loadu_ps( &matrixB[4] ) , 1 );
+	__m256 column2 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( &matrixA[8] ) ) , _mm_loadu_ps( &matrixB[8] ) , 1 );
+	__m256 column3 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( &matrixA[12] ) ), _mm_loadu_ps( &matrixB[12] ), 1 );
+
+	//Both weights are next to each other in the stream
+	__m256 weightPair	= _mm256_loadu_ps( &streams.weightPositions[weight].x );
+	__m256 bias			= _mm256_permute_ps( weightPair, _MM_SHUFFLE( 3, 3, 3, 3 ) );
+	__m256 positionX	= _mm256_permute_ps( weightPair, _MM_SHUFFLE( 0, 0, 0, 0 ) );
+	__m256 positionY	= _mm256_permute_ps( weightPair, _MM_SHUFFLE( 1, 1, 1, 1 ) );
+	__m256 positionZ	= _mm256_permute_ps( weightPair, _MM_SHUFFLE( 2, 2, 2, 2 ) );
+
+	__m256 position	= _mm256_fmadd_ps( column0, positionX, _mm256_fmadd_ps( column1, positionY, _mm256_fmadd_ps( column2, positionZ, column3 ) ) );
+	__m256 normal	= _mm256_fmadd_ps( column0, normalX, _mm256_fmadd_ps( column1, normalY, _mm256_mul_ps( column2, normalZ ) ) );
+
+	positionPair	= _mm256_fmadd_ps( position, bias, positionPair );
+	normalPair		= _mm256_fmadd_ps( normal, bias, normalPair );
+}
+#endif
+#if defined( SKINNING_KERNEL_SSE )
+/*
+=============
+GatherMatrixColumn
+
+	Loads one column of four joint matricies, one matrix per
+	lane, and transposes it so x, y and z each hold a row.
+	The w row is never used so it isn't built.
+=============
+*/
+static inline void GatherMatrixColumn( const float* const matricies[4], unsigned column, __m128& x, __m128& y, __m128& z ) {
+	__m128 lane0 = _mm_loadu_ps( &matricies[0][column * 4] );
+	__m128 lane1 = _mm_loadu_ps( &matricies[1][column * 4] );
+	__m128 lane2 = _mm_loadu_ps( &matricies[2][column * 4] );
+	__m128 lane3 = _mm_loadu_ps( &matricies[3][column * 4] );
+
+	__m128 xy01 = _mm_unpacklo_ps( lane0, lane1 );
+	__m128 xy23 = _mm_unpacklo_ps( lane2, lane3 );
+	__m128 zw01 = _mm_unpackhi_ps( lane0, lane1 );
+	__m128 zw23 = _mm_unpackhi_ps( lane2, lane3 );
+
+	x = _mm_movelh_ps( xy01, xy23 );
+	y = _mm_movehl_ps( xy23, xy01 );
+	z = _mm_movelh_ps( zw01, zw23 );
+}
+/*
+=============
+SkinVertexQuad
+
+	Skins four neighbouring verticies, one per lane.
+	Each step gathers one weight of every vertex, so all
+	four lanes do useful work. With ANY_WEIGHT_COUNT the
+	lanes past their vertex's last weight get a zero bias.
+=============
+*/
+template<unsigned WeightCount>
+static inline void SkinVertexQuad( const float* matrixFloats, const SkinningStreams& streams, unsigned vertexIndex, float* destination ) {
+	const VertexWeightRange*	weightRanges	= &streams.weightRanges[vertexIndex];
+	const glm::vec3*			jointNormals	= &streams.jointNormals[vertexIndex];
+	unsigned					countWeight		= WeightCount;
+	__m128i						laneCounts		= _mm_setzero_si128();
+
+	if ( WeightCount == ANY_WEIGHT_COUNT ) {
+		countWeight	= std::max( std::max( weightRanges[0].countWeight, weightRanges[1].countWeight ), std::max( weightRanges[2].countWeight, weightRanges[3].countWeight ) );
+		laneCounts	= _mm_setr_epi32( weightRanges[0].countWeight, weightRanges[1].countWeight, weightRanges[2].countWeight, weightRanges[3].countWeight );
+	}
+
+	__m128 normalX = _mm_setr_ps( jointNormals[0].x, jointNormals[1].x, jointNormals[2].x, jointNormals[3].x );
+	__m128 normalY = _mm_setr_ps( jointNormals[0].y, jointNormals[1].y, jointNormals[2].y, jointNormals[3].y );
+	__m128 normalZ = _mm_setr_ps( jointNormals[0].z, jointNormals[1].z, jointNormals[2].z, jointNormals[3].z );
+
+	__m128 vertexPositionX	= _mm_setzero_ps();
+	__m128 vertexPositionY	= _mm_setzero_ps();
+	__m128 vertexPositionZ	= _mm_setzero_ps();
+	__m128 vertexNormalX	= _mm_setzero_ps();
+	__m128 vertexNormalY	= _mm_setzero_ps();
+	__m128 vertexNormalZ	= _mm_setzero_ps();
+
+	for ( unsigned i = 0; i < countWeight; ++i ) {
+		unsigned		weights[4];
+		const float*	matricies[4];
+		for ( unsigned lane = 0; lane < 4; ++lane ) {
+			//Lanes that ran out of weights read weight 0, their bias is masked off
+			bool used		= ( WeightCount != ANY_WEIGHT_COUNT ) || i < weightRanges[lane].countWeight;
+			weights[lane]	= used ? weightRanges[lane].startWeight + i : 0;
+			matricies[lane]	= &matrixFloats[streams.weightJoints[weights[lane]] * 16];
+		}
+
+		__m128 positionX	= _mm_loadu_ps( &streams.weightPositions[weights[0]].x );
+		__m128 positionY	= _mm_loadu_ps( &streams.weightPositions[weights[1]].x );
+		__m128 positionZ	= _mm_loadu_ps( &streams.weightPositions[weights[2]].x );
+		__m128 bias			= _mm_loadu_ps( &streams.weightPositions[weights[3]].x );
+		_MM_TRANSPOSE4_PS( positionX, positionY, positionZ, bias );
+
+		if ( WeightCount == ANY_WEIGHT_COUNT ) {
+			bias = _mm_and_ps( bias, _mm_castsi128_ps( _mm_cmpgt_epi32( laneCounts, _mm_set1_epi32( ( int )i ) ) ) );
+		}
+
+		__m128 column0X, column0Y, column0Z;
+		__m128 column1X, column1Y, column1Z;
+		__m128 column2X, column2Y, column2Z;
+		__m128 column3X, column3Y, column3Z;
+		GatherMatrixColumn( matricies, 0, column0X, column0Y, column0Z );
+		GatherMatrixColumn( matricies, 1, column1X, column1Y, column1Z );
+		GatherMatrixColumn( matricies, 2, column2X, column2Y, column2Z );
+		GatherMatrixColumn( matricies, 3, column3X, column3Y, column3Z );
+
+		__m128 x = _mm_add_ps( _mm_add_ps( _mm_mul_ps( column0X, positionX ), _mm_mul_ps( column1X, positionY ) ), _mm_add_ps( _mm_mul_ps( column2X, positionZ ), column3X ) );
+		__m128 y = _mm_add_ps( _mm_add_ps( _mm_mul_ps( column0Y, positionX ), _mm_mul_ps( column1Y, positionY ) ), _mm_add_ps( _mm_mul_ps( column2Y, positionZ ), column3Y ) );
+		__m128 z = _mm_add_ps( _mm_add_ps( _mm_mul_ps( column0Z, positionX ), _mm_mul_ps( column1Z, positionY ) ), _mm_add_ps( _mm_mul_ps( column2Z, positionZ ), column3Z ) );
+		vertexPositionX	= _mm_add_ps( vertexPositionX, _mm_mul_ps( x, bias ) );
+		vertexPositionY	= _mm_add_ps( vertexPositionY, _mm_mul_ps( y, bias ) );
+		vertexPositionZ	= _mm_add_ps( vertexPositionZ, _mm_mul_ps( z, bias ) );
+
+		x = _mm_add_ps( _mm_add_ps( _mm_mul_ps( column0X, normalX ), _mm_mul_ps( column1X, normalY ) ), _mm_mul_ps( column2X, normalZ ) );
+		y = _mm_add_ps( _mm_add_ps( _mm_mul_ps( column0Y, normalX ), _mm_mul_ps( column1Y, normalY ) ), _mm_mul_ps( column2Y, normalZ ) );
+		z = _mm_add_ps( _mm_add_ps( _mm_mul_ps( column0Z, normalX ), _mm_mul_ps( column1Z, normalY ) ), _mm_mul_ps( column2Z, normalZ ) );
+		vertexNormalX	= _mm_add_ps( vertexNormalX, _mm_mul_ps( x, bias ) );
+		vertexNormalY	= _mm_add_ps( vertexNormalY, _mm_mul_ps( y, bias ) );
+		vertexNormalZ	= _mm_add_ps( vertexNormalZ, _mm_mul_ps( z, bias ) );
+	}
+
+	float values[6][4];
+	_mm_storeu_ps( values[0], vertexPositionX );
+	_mm_storeu_ps( values[1], vertexPositionY );
+	_mm_storeu_ps( values[2], vertexPositionZ );
+	_mm_storeu_ps( values[3], vertexNormalX );
+	_mm_storeu_ps( values[4], vertexNormalY );
+	_mm_storeu_ps( values[5], vertexNormalZ );
+	for ( unsigned lane = 0; lane < 4; ++lane ) {
+		for ( unsigned value = 0; value < 6; ++value ) {
+			destination[lane * 6 + value] = values[value][lane];
+		}
+	}
+}
+#endif
+/*
+=============
+SkinVertexSIMD
+
+	Skins one vertex. The AVX2 kernel runs two weights side
+	by side and leaves the odd weight to the SSE step.
+	The SSE kernel only uses it for the verticies left
+	over after SkinVertexQuad.
+=============
+*/
+template<unsigned WeightCount>
+static inline void SkinVertexSIMD( const float* matrixFloats, const SkinningStreams& streams, unsigned vertexIndex, float* destination ) {
+	const VertexWeightRange&	weightRange	= streams.weightRanges[vertexIndex];
+	const glm::vec3&			jointNormal	= streams.jointNormals[vertexIndex];
+	const unsigned				firstWeight	= weightRange.startWeight;
+	const unsigned				countWeight	= ( WeightCount != ANY_WEIGHT_COUNT ) ? WeightCount : weightRange.countWeight;
+	unsigned					i			= 0;
+
+	__m128 vertexPosition	= _mm_setzero_ps();
+	__m128 vertexNormal		= _mm_setzero_ps();
+
+#if defined( SKINNING_KERNEL_AVX2 )
+	__m256 positionPair	= _mm256_setzero_ps();
+	__m256 normalPair	= _mm256_setzero_ps();
+	__m256 normalPairX	= _mm256_set1_ps( jointNormal.x );
+	__m256 normalPairY	= _mm256_set1_ps( jointNormal.y );
+	__m256 normalPairZ	= _mm256_set1_ps( jointNormal.z );
+
+	for ( ; i + 1 < countWeight; i += 2 ) {
+		AccumulateWeightPair( matrixFloats, streams, firstWeight + i, normalPairX, normalPairY, normalPairZ, positionPair, normalPair );
+	}
+
+	vertexPosition	= _mm_add_ps( _mm256_castps256_ps128( positionPair ), _mm256_extractf128_ps( positionPair, 1 ) );
+	vertexNormal	= _mm_add_ps( _mm256_castps256_ps128( normalPair ), _mm256_extractf128_ps( normalPair, 1 ) );
+#endif
+
+	__m128 normalX = _mm_set1_ps( jointNormal.x );
+	__m128 normalY = _mm_set1_ps( jointNormal.y );
+	__m128 normalZ = _mm_set1_ps( jointNormal.z );
+
+	for ( ; i < countWeight; ++i ) {
+		AccumulateWeight( matrixFloats, streams, firstWeight + i, normalX, normalY, normalZ, vertexPosition, vertexNormal );
+	}
+
+	StoreSkinnedVertex( vertexPosition, vertexNormal, destination );
+}
+#endif
+/*
+=============
+SkinVertexRange
+
+	Skins a range of verticies with the fastest vertex kernel built in.
+=============
+*/
+template<unsigned WeightCount>
+static void SkinVertexRange( const SkinningStreams& streams, const glm::mat4* jointMatricies, unsigned firstVertex, unsigned vertexCount, float* destination ) {
+#if defined( SKINNING_KERNEL_AVX2 ) || defined( SKINNING_KERNEL_SSE )
+	const float*	matrixFloats	= &jointMatricies[0][0][0];
+	unsigned		vertexIndex		= firstVertex;
+#if defined( SKINNING_KERNEL_SSE )
+	for ( ; vertexIndex + 4 <= firstVertex + vertexCount; vertexIndex += 4 ) {
+		SkinVertexQuad<WeightCount>( matrixFloats, streams, vertexIndex, &destination[vertexIndex * 6] );
+	}
+#endif
+	for ( ; vertexIndex < firstVertex + vertexCount; ++vertexIndex ) {
+		SkinVertexSIMD<WeightCount>( matrixFloats, streams, vertexIndex, &destination[vertexIndex * 6] );
+	}
+#else
+	for ( unsigned vertexIndex = firstVertex; vertexIndex < firstVertex + vertexCount; ++vertexIndex ) {
+		SkinVertexScalar<WeightCount>( streams, jointMatricies, vertexIndex, &destination[vertexIndex * 6] );
+	}
+#endif
+}
+/*
+=============
+SkinningKernel::SkinVerticies
+
+	Skins a range of verticies with any number of weights each.
+=============
+*/
+void SkinningKernel::SkinVerticies( const SkinningStreams& streams, const glm::mat4* jointMatricies, unsigned firstVertex, unsigned vertexCount, float* destination ) {
+	SkinVertexRange<ANY_WEIGHT_COUNT>( streams, jointMatricies, firstVertex, vertexCount, destination );
+}
+/*
+=============
+SkinningKernel::SkinVerticiesBucket
+
+	Skins a range of verticies that all have countWeight weights.
+	1 to 4 weights use kernels with the weight loop unrolled,
+	so there are no data dependent branches per vertex.
+=============
+*/
+void SkinningKernel::SkinVerticiesBucket( const SkinningStreams& streams, const glm::mat4* jointMatricies, unsigned countWeight, unsigned firstVertex, unsigned vertexCount, float* destination ) {
+	switch ( countWeight ) {
+		case 1:		SkinVertexRange<1>( streams, jointMatricies, firstVertex, vertexCount, destination ); break;
+		case 2:		SkinVertexRange<2>( streams, jointMatricies, firstVertex, vertexCount, destination ); break;
+		case 3:		SkinVertexRange<3>( streams, jointMatricies, firstVertex, vertexCount, destination ); break;
+		case 4:		SkinVertexRange<4>( streams, jointMatricies, firstVertex, vertexCount, destination ); break;
+		default:	SkinVertexRange<ANY_WEIGHT_COUNT>( streams, jointMatricies, firstVertex, vertexCount, destination ); break;
+	}
+}
+/*
+=============
+SkinningKernel::SkinVerticiesPalette
+
+	Skins a range of verticies from a 4 bone matrix palette
+	with the fastest kernel built in.
+=============
+*/
+void SkinningKernel::SkinVerticiesPalette( const PaletteSkinningStreams& streams, const glm::mat4* palette, unsigned firstVertex, unsigned vertexCount, float* destination ) {
+#if defined( SKINNING_KERNEL_AVX2 ) || defined( SKINNING_KERNEL_SSE )
+	SkinVerticiesPaletteSIMD( streams, palette, firstVertex, vertexCount, destination );
+#else
+	SkinVerticiesPaletteScalar( streams, palette, firstVertex, vertexCount, destination );
+#endif
+}
+/*
+=============
+SkinningKernel::GetName
+
+	Returns the name of the kernel SkinVerticies uses.
+=============
+*/
+const char* SkinningKernel::GetName( void ) {
+#if defined( SKINNING_KERNEL_AVX2 )
+	return "AVX2";
+#elif defined( SKINNING_KERNEL_SSE )
+	return "SSE";
+#else
+	return "Scalar";
+#endif
+}
+/*
+=============
+SkinningKernel::SkinVerticiesScalar
+
+	Skins a range of verticies one weight at a time.
+	Works everywhere and is the reference for the SIMD kernels.
+=============
+*/
+void SkinningKernel::SkinVerticiesScalar( const SkinningStreams& streams, const glm::mat4* jointMatricies, unsigned firstVertex, unsigned vertexCount, float* destination ) {
+	for ( unsigned vertexIndex = firstVertex; vertexIndex < firstVertex + vertexCount; ++vertexIndex ) {
+		SkinVertexScalar<ANY_WEIGHT_COUNT>( streams, jointMatricies, vertexIndex, &destination[vertexIndex * 6] );
+	}
+}
+/*
+=============
+SkinningKernel::SkinVerticiesPaletteScalar
+
+	Skins a range of verticies the way the GPU skinning shader does.
+	The 4 palette matricies are blended by weight and the
+	blended matrix transforms the bind position and normal.
+=============
+*/
+void SkinningKernel::SkinVerticiesPaletteScalar( const PaletteSkinningStreams& streams, const glm::mat4* palette, unsigned firstVertex, unsigned vertexCount, float* destination ) {
+	for ( unsigned vertexIndex = firstVertex; vertexIndex < firstVertex + vertexCount; ++vertexIndex ) {
+		const unsigned short*	boneJoints	= &streams.boneJoints[vertexIndex * 4];
+		const glm::vec4&		boneWeights	= streams.boneWeights[vertexIndex];
+
+		glm::mat4 matrix = palette[boneJoints[0]] * boneWeights.x;
+		matrix += palette[boneJoints[1]] * boneWeights.y;
+		matrix += palette[boneJoints[2]] * boneWeights.z;
+		matrix += palette[boneJoints[3]] * boneWeights.w;
+
+		glm::vec4 vertexPosition	= matrix * streams.bindPositions[vertexIndex];
+		glm::vec4 vertexNormal		= matrix * streams.bindNormals[vertexIndex];
+
+		float* currentValues = &destination[vertexIndex * 6];
+		memcpy( &currentValues[0], &vertexPosition[0], sizeof( float ) * 3 ); //Vertex Position
+		memcpy( &currentValues[3], &vertexNormal[0]  , sizeof( float ) * 3 ); //Vertex Normal
+	}
+}
+/*
+=============
+SkinningKernel::SkinVerticiesDualQuaternion
+
+	Skins a range of verticies the way the GPU dual quaternion
+	shader does, with the functions in DualQuaternion.h.
+	The 4 palette entries are blended by weight and the
+	blend moves the bind position and rotates the bind normal.
+=============
+*/
+void SkinningKernel::SkinVerticiesDualQuaternion( const PaletteSkinningStreams& streams, const DualQuaternion* palette, unsigned firstVertex, unsigned vertexCount, float* destination ) {
+	for ( unsigned vertexIndex = firstVertex; vertexIndex < firstVertex + vertexCount; ++vertexIndex ) {
+		DualQuaternion blended = BlendDualQuaternions( palette, &streams.boneJoints[vertexIndex * 4], streams.boneWeights[vertexIndex] );
+
+		glm::vec3 vertexPosition	= DualQuaternionTransformPoint( blended, glm::vec3( streams.bindPositions[vertexIndex] ) );
+		glm::vec3 vertexNormal		= DualQuaternionRotateVector( blended, glm::vec3( streams.bindNormals[vertexIndex] ) );
+
+		float* currentValues = &destination[vertexIndex * 6];
+		memcpy( &currentValues[0], &vertexPosition[0], sizeof( float ) * 3 ); //Vertex Position
+		memcpy( &currentValues[3], &vertexNormal[0]  , sizeof( float ) * 3 ); //Vertex Normal
+	}
+}
+
+#if defined( SKINNING_KERNEL_AVX2 ) || defined( SKINNING_KERNEL_SSE )
+/*
+=============
+SkinningKernel::SkinVerticiesPaletteSIMD
+
+	Blends the 4 palette matricies a column per register and
+	transforms the bind position and normal with the result.
+	The AVX2 kernel blends two columns per register.
+=============
+*/
+void SkinningKernel::SkinVerticiesPaletteSIMD( const PaletteSkinningStreams& streams, const glm::mat4* palette, unsigned firstVertex, unsigned vertexCount, float* destination ) {
+	const float* paletteFloats = &palette[0][0][0];
+
+	for ( unsigned vertexIndex = firstVertex; vertexIndex < firstVertex + vertexCount; ++vertexIndex ) {
+		const unsigned short*	boneJoints	= &streams.boneJoints[vertexIndex * 4];
+		const glm::vec4&		boneWeights	= streams.boneWeights[vertexIndex];
+
+#if defined( SKINNING_KERNEL_AVX2 )
+		__m256 column01 = _mm256_setzero_ps();
+		__m256 column23 = _mm256_setzero_ps();
+		for ( unsigned bone = 0; bone < 4; ++bone ) {
+			const float*	matrix	= &paletteFloats[boneJoints[bone] * 16];
+			__m256			weight	= _mm256_set1_ps( boneWeights[bone] );
+
+			column01 = _mm256_fmadd_ps( _mm256_loadu_ps( &matrix[0] ), weight, column01 );
+			column23 = _mm256_fmadd_ps( _mm256_loadu_ps( &matrix[8] ), weight, column23 );
+		}
+
+		__m128 column0 = _mm256_castps256_ps128( column01 );
+		__m128 column1 = _mm256_extractf128_ps( column01, 1 );
+		__m128 column2 = _mm256_castps256_ps128( column23 );
+		__m128 column3 = _mm256_extractf128_ps( column23, 1 );
+#else
+		__m128 column0 = _mm_setzero_ps();
+		__m128 column1 = _mm_setzero_ps();
+		__m128 column2 = _mm_setzero_ps();
+		__m128 column3 = _mm_setzero_ps();
+		for ( unsigned bone = 0; bone < 4; ++bone ) {
+			const float*	matrix	= &paletteFloats[boneJoints[bone] * 16];
+			__m128			weight	= _mm_set1_ps( boneWeights[bone] );
+
+			column0 = _mm_add_ps( column0, _mm_mul_ps( _mm_loadu_ps( &matrix[0] ) , weight ) );
+			column1 = _mm_add_ps( column1, _mm_mul_ps( _mm_loadu_ps( &matrix[4] ) , weight ) );
+			column2 = _mm_add_ps( column2, _mm_mul_ps( _mm_loadu_ps( &matrix[8] ) , weight ) );
+			column3 = _mm_add_ps( column3, _mm_mul_ps( _mm_loadu_ps( &matrix[12] ), weight ) );
+		}
+#endif
+
+		const glm::vec4& bindPosition	= streams.bindPositions[vertexIndex];
+		const glm::vec4& bindNormal		= streams.bindNormals[vertexIndex];
+
+		__m128 normalXY			= _mm_add_ps( _mm_mul_ps( column0, _mm_set1_ps( bindNormal.x ) ), _mm_mul_ps( column1, _mm_set1_ps( bindNormal.y ) ) );
+		__m128 positionXY		= _mm_add_ps( _mm_mul_ps( column0, _mm_set1_ps( bindPosition.x ) ), _mm_mul_ps( column1, _mm_set1_ps( bindPosition.y ) ) );
+		__m128 vertexNormal		= _mm_add_ps( normalXY, _mm_mul_ps( column2, _mm_set1_ps( bindNormal.z ) ) );
+		__m128 vertexPosition	= _mm_add_ps( positionXY, _mm_add_ps( _mm_mul_ps( column2, _mm_set1_ps( bindPosition.z ) ), column3 ) );
+
+		StoreSkinnedVertex( vertexPosition, vertexNormal, &destination[vertexIndex * 6] );
+	}
+}
+#else
+/*
+=============
+SkinningKernel::SkinVerticiesPaletteSIMD
+
+	No SIMD kernel was built, use the scalar one.
+=============
+*/
+void SkinningKernel::SkinVerticiesPaletteSIMD( const PaletteSkinningStreams& streams, const glm::mat4* palette, unsigned firstVertex, unsigned vertexCount, float* destination ) {
+	SkinVerticiesPaletteScalar( streams, palette, firstVertex, vertexCount, destination );
+}
+#endif
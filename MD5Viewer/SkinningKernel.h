@@ -0,0 +1,91 @@
+#ifndef __SKINNINGKERNEL_H__
+#define __SKINNINGKERNEL_H__
+
+#include <glm\glm.hpp>
+#include "MD5ModelStructs.h"
+#include "DualQuaternion.h"
+
+//Picked at compile time, /arch:AVX2 enables the AVX2 kernel
+//The AVX2 kernel uses FMA, /arch:AVX2 implies it but other compilers need it enabled too
+//SSE2 is always there on x64 and with /arch:SSE2 on x86, the SSE kernel skins 4 verticies at a time
+#if defined( __AVX2__ ) && ( defined( __FMA__ ) || defined( _MSC_VER ) )
+	#define SKINNING_KERNEL_AVX2
+#elif defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) || defined( __SSE2__ )
+	#define SKINNING_KERNEL_SSE
+#endif
+/*
+========================
+
+	SkinningStreams
+
+		The per vertex and per weight arrays
+		CPU skinning reads, all owned by a mesh.
+
+========================
+*/
+struct SkinningStreams {
+	const VertexWeightRange*	weightRanges;		//Per vertex
+	const glm::vec3*			jointNormals;		//Per vertex
+	const glm::vec4*			weightPositions;	//Per weight, position in xyz and bias in w
+	const unsigned*				weightJoints;		//Per weight
+
+	SkinningStreams( void ) :
+		weightRanges( NULL ),
+		jointNormals( NULL ),
+		weightPositions( NULL ),
+		weightJoints( NULL )
+	{}
+};
+/*
+========================
+
+	PaletteSkinningStreams
+
+		The per vertex arrays 4 bone palette
+		skinning reads, all owned by a mesh.
+
+========================
+*/
+struct PaletteSkinningStreams {
+	const glm::vec4*		bindPositions;		//w is 1
+	const glm::vec4*		bindNormals;		//w is 0
+	const glm::vec4*		boneWeights;		//Top 4 weights, sum to 1
+	const unsigned short*	boneJoints;			//4 per vertex
+
+	PaletteSkinningStreams( void ) :
+		bindPositions( NULL ),
+		bindNormals( NULL ),
+		boneWeights( NULL ),
+		boneJoints( NULL )
+	{}
+};
+/*
+========================
+
+	SkinningKernel
+
+		Skins verticies on the CPU from the skeleton's
+		joint matricies, from a palette of joint
+		matricies times inverse bind matricies, or from
+		a palette of dual quaternions.
+		Each vertex is written as a position and normal,
+		6 floats, at its own index so vertex ranges can
+		be skinned separately.
+
+========================
+*/
+class SkinningKernel {
+public:
+	static void			SkinVerticies( const SkinningStreams& streams, const glm::mat4* jointMatricies, unsigned firstVertex, unsigned vertexCount, float* destination );
+	static void			SkinVerticiesBucket( const SkinningStreams& streams, const glm::mat4* jointMatricies, unsigned countWeight, unsigned firstVertex, unsigned vertexCount, float* destination );
+	static void			SkinVerticiesScalar( const SkinningStreams& streams, const glm::mat4* jointMatricies, unsigned firstVertex, unsigned vertexCount, float* destination );
+	static void			SkinVerticiesPalette( const PaletteSkinningStreams& streams, const glm::mat4* palette, unsigned firstVertex, unsigned vertexCount, float* destination );
+	static void			SkinVerticiesPaletteScalar( const PaletteSkinningStreams& streams, const glm::mat4* palette, unsigned firstVertex, unsigned vertexCount, float* destination );
+	static void			SkinVerticiesDualQuaternion( const PaletteSkinningStreams& streams, const DualQuaternion* palette, unsigned firstVertex, unsigned vertexCount, float* destination );
+	static const char*	GetName( void );
+
+private:
+	static void			SkinVerticiesPaletteSIMD( const PaletteSkinningStreams& streams, const glm::mat4* palette, unsigned firstVertex, unsigned vertexCount, float* destination );
+};
+
+#endif //__SKINNINGKERNEL_H__
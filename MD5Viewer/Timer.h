@@ -0,0 +1,50 @@
+#ifndef __TIMER_H__
+#define __TIMER_H__
+
+#if defined( _WIN32 )
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <chrono>
+#endif
+
+#if defined( _WIN32 )
+/*
+=============
+QueryTicksPerMillisecond
+
+	Performance counter frequency, it's fixed at boot.
+=============
+*/
+inline double QueryTicksPerMillisecond( void ) {
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency( &frequency );
+	return ( double )frequency.QuadPart / 1000.0;
+}
+#endif
+/*
+=============
+GetTimeMilliseconds
+
+	High resolution timer for measuring update and skinning costs.
+	Call it once on the main thread before jobs use it, local
+	statics aren't initialized thread safely before VS2015.
+=============
+*/
+inline double GetTimeMilliseconds( void ) {
+#if defined( _WIN32 )
+	static const double ticksPerMillisecond = QueryTicksPerMillisecond();
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter( &counter );
+	return ( double )counter.QuadPart / ticksPerMillisecond;
+#else
+	return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+#endif
+}
+
+#endif //__TIMER_H__
@@ -0,0 +1,84 @@
+#version 330
+
+// vertex attributes
+layout(location = 0) in vec4 inVertex;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUV;
+layout(location = 3) in vec4 inWeight;
+layout(location = 4) in uvec4 inMatrixIndex;
+
+// every keyframe's skinning palette, 3 texels (rows of a 3x4 matrix) per bone
+uniform samplerBuffer uAnimationBuffer;
+
+// playback state of the clip
+uniform float uAnimationTime;   // seconds into the clip, already wrapped or clamped
+uniform float uFrameRate;
+uniform int   uFrameCount;
+uniform int   uJointCount;
+uniform int   uClipOffset;      // first texel of the clip in uAnimationBuffer
+uniform int   uLoop;            // 1 to interpolate the last frame into the first
+
+// transformations
+uniform mat4 uProjectionMatrix;
+uniform mat4 uModelMatrix;
+uniform mat4 uViewMatrix;
+uniform mat3 uNormalMatrix;
+
+// light info
+uniform vec3 uLightColor;
+uniform vec3 uLightDir;
+
+// material color
+uniform vec3 uMatColor;
+
+// outputs to rasterizer
+smooth out vec3 interpColor;
+smooth out vec2 outUV;
+
+// fetches row of a bone's matrix in a keyframe
+vec4 FetchRow( int frame, int bone, int row )
+{
+    return texelFetch( uAnimationBuffer, uClipOffset + ( frame * uJointCount + bone ) * 3 + row );
+}
+
+void main()
+{
+    // find the two keyframes around the time, the same way the CPU does
+    float framePosition = uAnimationTime * uFrameRate;
+    if ( uLoop == 0 ) {
+        framePosition = clamp( framePosition, 0.0, float( uFrameCount - 1 ) );
+    }
+    int   frame0 = min( int( framePosition ), uFrameCount - 1 );
+    int   frame1 = ( frame0 + 1 < uFrameCount ) ? frame0 + 1 : ( ( uLoop != 0 ) ? 0 : frame0 );
+    float amount = clamp( framePosition - float( frame0 ), 0.0, 1.0 );
+
+    int   bones[4]   = int[4]( int(inMatrixIndex.x), int(inMatrixIndex.y), int(inMatrixIndex.z), int(inMatrixIndex.w) );
+    float weights[4] = float[4]( inWeight.x, inWeight.y, inWeight.z, inWeight.w );
+
+    // weighted sum of the interpolated bone rows
+    vec4 row0 = vec4( 0.0 );
+    vec4 row1 = vec4( 0.0 );
+    vec4 row2 = vec4( 0.0 );
+    for ( int i = 0; i < 4; ++i ) {
+        if ( weights[i] > 0.0 ) {
+            row0 += weights[i] * mix( FetchRow( frame0, bones[i], 0 ), FetchRow( frame1, bones[i], 0 ), amount );
+            row1 += weights[i] * mix( FetchRow( frame0, bones[i], 1 ), FetchRow( frame1, bones[i], 1 ), amount );
+            row2 += weights[i] * mix( FetchRow( frame0, bones[i], 2 ), FetchRow( frame1, bones[i], 2 ), amount );
+        }
+    }
+
+    vec4 skinnedVertex = vec4( dot( row0, inVertex ), dot( row1, inVertex ), dot( row2, inVertex ), 1.0 );
+    vec3 vertexNormal  = vec3( dot( row0.xyz, inNormal ), dot( row1.xyz, inNormal ), dot( row2.xyz, inNormal ) );
+
+    gl_Position = uProjectionMatrix * uViewMatrix * uModelMatrix * skinnedVertex;
+
+	// can remove these normalizations if we're absolutely sure that normals and light directions are unit vectors
+	vec3 N = normalize(uNormalMatrix * vertexNormal);	// transform surface normal
+	vec3 L = normalize(-uLightDir);					// compute direction to light
+
+	// compute diffuse lighting intensity
+	float NdotL = max(dot(N, L), 0.5);	// assumes N and L are unit vectors; clamps negative values to 0
+
+	interpColor = NdotL * uLightColor * uMatColor;
+	outUV = inUV;
+}
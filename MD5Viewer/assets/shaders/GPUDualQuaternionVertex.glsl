@@ -0,0 +1,78 @@
+#version 330
+
+// vertex attributes
+layout(location = 0) in vec4 inVertex;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUV;
+layout(location = 3) in vec4 inWeight;
+layout(location = 4) in uvec4 inMatrixIndex;
+
+// 2 texels per bone, the real part then the dual part
+uniform samplerBuffer uMatriciesBuffer; 
+
+// transformations
+uniform mat4 uProjectionMatrix;
+uniform mat4 uModelMatrix;
+uniform mat4 uViewMatrix;
+uniform mat3 uNormalMatrix;
+
+// light info
+uniform vec3 uLightColor;
+uniform vec3 uLightDir;
+
+// material color
+uniform vec3 uMatColor;
+
+// outputs to rasterizer 
+smooth out vec3 interpColor;
+smooth out vec2 outUV;
+
+// same math as DualQuaternion.h
+vec3 DualQuaternionTransformPoint( vec4 real, vec4 dual, vec3 point )
+{
+    vec3 rotated     = point + 2.0 * cross( real.xyz, cross( real.xyz, point ) + real.w * point );
+    vec3 translation = 2.0 * ( real.w * dual.xyz - dual.w * real.xyz + cross( real.xyz, dual.xyz ) );
+    return rotated + translation;
+}
+
+vec3 DualQuaternionRotateVector( vec4 real, vec3 vector )
+{
+    return vector + 2.0 * cross( real.xyz, cross( real.xyz, vector ) + real.w * vector );
+}
+
+void main()
+{   
+    int   bones[4]   = int[4]( int(inMatrixIndex.x), int(inMatrixIndex.y), int(inMatrixIndex.z), int(inMatrixIndex.w) );
+    float weights[4] = float[4]( inWeight.x, inWeight.y, inWeight.z, inWeight.w );
+
+    // blend around the first bone's hemisphere so the blend takes the short way
+    vec4 pivot = texelFetch( uMatriciesBuffer, bones[0] * 2 );
+    vec4 real  = vec4( 0.0 );
+    vec4 dual  = vec4( 0.0 );
+    for ( int i = 0; i < 4; ++i ) {
+        vec4  boneReal = texelFetch( uMatriciesBuffer, bones[i] * 2 + 0 );
+        vec4  boneDual = texelFetch( uMatriciesBuffer, bones[i] * 2 + 1 );
+        float weight   = ( dot( pivot, boneReal ) < 0.0 ) ? -weights[i] : weights[i];
+        real += weight * boneReal;
+        dual += weight * boneDual;
+    }
+
+    float inverseLength = 1.0 / length( real );
+    real *= inverseLength;
+    dual *= inverseLength;
+
+    vec4 skinnedVertex = vec4( DualQuaternionTransformPoint( real, dual, inVertex.xyz ), 1.0 );
+    vec3 vertexNormal  = DualQuaternionRotateVector( real, inNormal );
+   
+    gl_Position = uProjectionMatrix * uViewMatrix * uModelMatrix * skinnedVertex;
+
+	// can remove these normalizations if we're absolutely sure that normals and light directions are unit vectors
+	vec3 N = normalize(uNormalMatrix * vertexNormal);	// transform surface normal
+	vec3 L = normalize(-uLightDir);					// compute direction to light
+
+	// compute diffuse lighting intensity
+	float NdotL = max(dot(N, L), 0.5);	// assumes N and L are unit vectors; clamps negative values to 0
+
+	interpColor = NdotL * uLightColor * uMatColor; 
+	outUV = inUV;
+}
@@ -5,7 +5,7 @@ layout(location = 0) in vec4 inVertex;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inUV;
 layout(location = 3) in vec4 inWeight;
-layout(location = 4) in vec4 inMatrixIndex;
+layout(location = 4) in uvec4 inMatrixIndex;
 
 uniform samplerBuffer uMatriciesBuffer; 
 
@@ -26,38 +26,34 @@ uniform vec3 uMatColor;
 smooth out vec3 interpColor;
 smooth out vec2 outUV;
 
+// fetches row of a bone's packed 3x4 matrix
+vec4 FetchRow( int bone, int row )
+{
+    return texelFetch( uMatriciesBuffer, bone * 3 + row );
+}
+
 void main()
 {   
-    mat4 boneMatricies[4];
-    boneMatricies[0] = mat4( texelFetch( uMatriciesBuffer, int(inMatrixIndex.x) * 4 + 0 ),
-                             texelFetch( uMatriciesBuffer, int(inMatrixIndex.x) * 4 + 1 ),
-                             texelFetch( uMatriciesBuffer, int(inMatrixIndex.x) * 4 + 2 ),
-                             texelFetch( uMatriciesBuffer, int(inMatrixIndex.x) * 4 + 3 ) );
-    boneMatricies[1] = mat4( texelFetch( uMatriciesBuffer, int(inMatrixIndex.y) * 4 + 0 ),
-                             texelFetch( uMatriciesBuffer, int(inMatrixIndex.y) * 4 + 1 ),
-                             texelFetch( uMatriciesBuffer, int(inMatrixIndex.y) * 4 + 2 ),
-                             texelFetch( uMatriciesBuffer, int(inMatrixIndex.y) * 4 + 3 ) );
-    boneMatricies[2] = mat4( texelFetch( uMatriciesBuffer, int(inMatrixIndex.z) * 4 + 0 ),
-                             texelFetch( uMatriciesBuffer, int(inMatrixIndex.z) * 4 + 1 ),
-                             texelFetch( uMatriciesBuffer, int(inMatrixIndex.z) * 4 + 2 ),
-                             texelFetch( uMatriciesBuffer, int(inMatrixIndex.z) * 4 + 3 ) );
-    boneMatricies[3] = mat4( texelFetch( uMatriciesBuffer, int(inMatrixIndex.w) * 4 + 0 ),
-                             texelFetch( uMatriciesBuffer, int(inMatrixIndex.w) * 4 + 1 ),
-                             texelFetch( uMatriciesBuffer, int(inMatrixIndex.w) * 4 + 2 ),
-                             texelFetch( uMatriciesBuffer, int(inMatrixIndex.w) * 4 + 3 ) );
+    int   bones[4]   = int[4]( int(inMatrixIndex.x), int(inMatrixIndex.y), int(inMatrixIndex.z), int(inMatrixIndex.w) );
+    float weights[4] = float[4]( inWeight.x, inWeight.y, inWeight.z, inWeight.w );
 
+    // weighted sum of the bone rows, the bottom row is always 0 0 0 1
+    vec4 row0 = vec4( 0.0 );
+    vec4 row1 = vec4( 0.0 );
+    vec4 row2 = vec4( 0.0 );
+    for ( int i = 0; i < 4; ++i ) {
+        row0 += weights[i] * FetchRow( bones[i], 0 );
+        row1 += weights[i] * FetchRow( bones[i], 1 );
+        row2 += weights[i] * FetchRow( bones[i], 2 );
+    }
 
-    mat4 transformMat = boneMatricies[0] * inWeight.x;
-    transformMat     += boneMatricies[1] * inWeight.y;
-    transformMat     += boneMatricies[2] * inWeight.z;
-    transformMat     += boneMatricies[3] * inWeight.w;
-    
-    vec4 vertexNormal = transformMat * vec4( inNormal, 0.0 );
+    vec4 skinnedVertex = vec4( dot( row0, inVertex ), dot( row1, inVertex ), dot( row2, inVertex ), 1.0 );
+    vec3 vertexNormal  = vec3( dot( row0.xyz, inNormal ), dot( row1.xyz, inNormal ), dot( row2.xyz, inNormal ) );
    
-    gl_Position = uProjectionMatrix * uViewMatrix * uModelMatrix * transformMat * inVertex;
+    gl_Position = uProjectionMatrix * uViewMatrix * uModelMatrix * skinnedVertex;
 
 	// can remove these normalizations if we're absolutely sure that normals and light directions are unit vectors
-	vec3 N = normalize(uNormalMatrix * vec3(vertexNormal));	// transform surface normal
+	vec3 N = normalize(uNormalMatrix * vertexNormal);	// transform surface normal
 	vec3 L = normalize(-uLightDir);					// compute direction to light
 
 	// compute diffuse lighting intensity
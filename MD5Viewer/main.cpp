@@ -1,8 +1,16 @@
 #include "ModelViewer.h"
+#include <cstring>
 
-int main()
+int main( int argc, char** argv )
 {
     ModelViewer modelViewer;
 
+    //--memory-report prints the memory used by every model once they're loaded
+    for ( int i = 1; i < argc; ++i ) {
+        if ( strcmp( argv[i], "--memory-report" ) == 0 ) {
+            modelViewer.SetMemoryDumpEnabled( true );
+        }
+    }
+
    glsh::System::Run(modelViewer, "MD5 Model Viewer", 1280, 720);
 }